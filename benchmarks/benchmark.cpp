@@ -0,0 +1,463 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2014-2025 Patrizio Bekerle -- <patrizio@bekerle.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Benchmarks of the highlighter throughput and the editor latency
+ *
+ * The results can be written in a machine-readable format with the usual
+ * QtTest options, for example:
+ * qmarkdowntextedit-bench -o results.xml,xml -o -,txt
+ */
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QtTest>
+#include <algorithm>
+
+#include "markdownhighlighter.h"
+#include "qmarkdowntextedit.h"
+#include "qplaintexteditsearchwidget.h"
+
+namespace {
+
+/**
+ * Returns text with paragraphs, headlines, lists and links
+ */
+QString proseCorpus(int paragraphs) {
+    QString text;
+
+    for (int i = 0; i < paragraphs; ++i) {
+        text += QStringLiteral("## Section %1\n\n").arg(i);
+        text += QStringLiteral(
+            "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+            "eiusmod tempor incididunt ut labore et dolore magna aliqua. Ut "
+            "enim ad minim veniam, see [the docs](https://example.com/%1) "
+            "and <https://example.org>.\n\n"
+            "- first item of the list\n"
+            "- second item with `inline code`\n"
+            "> a quote of the section %1\n\n")
+                    .arg(i);
+    }
+
+    return text;
+}
+
+/**
+ * Returns text with a lot of nested emphasis
+ */
+QString emphasisCorpus(int lines) {
+    QString text;
+
+    for (int i = 0; i < lines; ++i) {
+        text += QStringLiteral(
+            "Some *italic*, **bold**, ***both***, _under_ and __strong__ "
+            "words, **bold with *italic* inside**, ~~struck~~ and "
+            "*unclosed **emphasis `code*` span** %1\n")
+                    .arg(i);
+    }
+
+    return text;
+}
+
+/**
+ * Returns text with markdown tables
+ */
+QString tablesCorpus(int tables) {
+    QString text;
+
+    for (int i = 0; i < tables; ++i) {
+        text += QStringLiteral("| Name | Value | Description |\n"
+                               "|------|:-----:|-------------|\n");
+        for (int row = 0; row < 20; ++row) {
+            text += QStringLiteral("| row %1 | **%2** | some `text` |\n")
+                        .arg(row)
+                        .arg(i);
+        }
+        text += QLatin1Char('\n');
+    }
+
+    return text;
+}
+
+/**
+ * Returns text with a big fenced code block for every known code language
+ */
+QString codeBlocksCorpus(int linesPerBlock) {
+    QStringList languages =
+        MarkdownHighlighter::defaultTheme()->langStringToEnum.keys();
+    languages.sort();
+    QString text;
+
+    for (const QString &language : languages) {
+        text += QStringLiteral("```%1\n").arg(language);
+        for (int i = 0; i < linesPerBlock; ++i) {
+            text += QStringLiteral(
+                        "if (value_%1 != nullptr) { return \"string %1\"; } "
+                        "// comment %1\n")
+                        .arg(i);
+        }
+        text += QStringLiteral("```\n\n");
+    }
+
+    return text;
+}
+
+/**
+ * Returns a note of a few megabytes with all kinds of content
+ */
+QString largeCorpus() {
+    const QString chunk = proseCorpus(20) + emphasisCorpus(50) +
+                          tablesCorpus(2) + codeBlocksCorpus(5);
+    QString text;
+
+    while (text.size() < 4 * 1024 * 1024) {
+        text += chunk;
+    }
+
+    return text;
+}
+
+QString corpus(const QString &name) {
+    if (name == QLatin1String("prose")) return proseCorpus(2000);
+    if (name == QLatin1String("emphasis")) return emphasisCorpus(10000);
+    if (name == QLatin1String("tables")) return tablesCorpus(500);
+    if (name == QLatin1String("codeblocks")) return codeBlocksCorpus(200);
+    return largeCorpus();
+}
+
+QStringList corpusNames() {
+    return {QStringLiteral("prose"), QStringLiteral("emphasis"),
+            QStringLiteral("tables"), QStringLiteral("codeblocks"),
+            QStringLiteral("large")};
+}
+
+qint64 percentile(QVector<qint64> values, int percent) {
+    std::sort(values.begin(), values.end());
+    const int index = (values.size() - 1) * percent / 100;
+    return values.at(index);
+}
+
+}    // namespace
+
+class QMarkdownTextEditBenchmark : public QObject {
+    Q_OBJECT
+
+   private Q_SLOTS:
+    void rehighlight_data();
+    void rehighlight();
+    void rehighlightThroughput_data();
+    void rehighlightThroughput();
+    void keystrokeLatency_data();
+    void keystrokeLatency();
+    void searchCount_data();
+    void searchCount();
+    void scrollPaint_data();
+    void scrollPaint();
+    void memoryUsage_data();
+    void memoryUsage();
+    void bulkEdit_data();
+    void bulkEdit();
+};
+
+void QMarkdownTextEditBenchmark::rehighlight_data() {
+    QTest::addColumn<QString>("text");
+
+    for (const QString &name : corpusNames()) {
+        QTest::newRow(name.toUtf8().constData()) << corpus(name);
+    }
+}
+
+/**
+ * Measures the time a rehighlight() of the whole document takes
+ */
+void QMarkdownTextEditBenchmark::rehighlight() {
+    QFETCH(QString, text);
+
+    QTextDocument document(text);
+    MarkdownHighlighter highlighter(&document);
+
+    QBENCHMARK { highlighter.rehighlight(); }
+}
+
+void QMarkdownTextEditBenchmark::rehighlightThroughput_data() {
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<bool>("bytes");
+
+    for (const QString &name : corpusNames()) {
+        const QString text = corpus(name);
+        QTest::newRow(qPrintable(name + QStringLiteral(" bytes/sec")))
+            << text << true;
+        QTest::newRow(qPrintable(name + QStringLiteral(" blocks/sec")))
+            << text << false;
+    }
+}
+
+/**
+ * Reports the bytes or blocks rehighlight() handles per second
+ */
+void QMarkdownTextEditBenchmark::rehighlightThroughput() {
+    QFETCH(QString, text);
+    QFETCH(bool, bytes);
+
+    QTextDocument document(text);
+    MarkdownHighlighter highlighter(&document);
+    QElapsedTimer timer;
+    int runs = 0;
+
+    timer.start();
+    do {
+        highlighter.rehighlight();
+        ++runs;
+    } while (runs < 3 || timer.elapsed() < 1000);
+
+    const double seconds = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+    const double amount =
+        bytes ? static_cast<double>(text.toUtf8().size())
+              : static_cast<double>(document.blockCount());
+
+    QTest::setBenchmarkResult(amount * runs / seconds,
+                              bytes ? QTest::BytesPerSecond : QTest::Events);
+}
+
+void QMarkdownTextEditBenchmark::keystrokeLatency_data() {
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<int>("percent");
+
+    for (const QString &name : corpusNames()) {
+        const QString text = corpus(name);
+        QTest::newRow(qPrintable(name + QStringLiteral(" p50")))
+            << text << 50;
+        QTest::newRow(qPrintable(name + QStringLiteral(" p99")))
+            << text << 99;
+    }
+}
+
+/**
+ * Reports the p50 or p99 latency of typing and removing a character in
+ * blocks all over the document, which mostly is the highlightBlock() time
+ */
+void QMarkdownTextEditBenchmark::keystrokeLatency() {
+    QFETCH(QString, text);
+    QFETCH(int, percent);
+
+    QTextDocument document(text);
+    MarkdownHighlighter highlighter(&document);
+    highlighter.rehighlight();
+
+    const int keystrokes = 1000;
+    const int blockCount = document.blockCount();
+    QVector<qint64> latencies;
+    latencies.reserve(keystrokes * 2);
+    QElapsedTimer timer;
+
+    for (int i = 0; i < keystrokes; ++i) {
+        const QTextBlock block =
+            document.findBlockByNumber(i * 7919 % blockCount);
+        QTextCursor cursor(block);
+        cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor,
+                            block.length() / 2);
+
+        timer.start();
+        cursor.insertText(QStringLiteral("x"));
+        latencies.append(timer.nsecsElapsed());
+
+        timer.start();
+        cursor.deletePreviousChar();
+        latencies.append(timer.nsecsElapsed());
+    }
+
+    const qint64 latency = percentile(latencies, percent);
+    QTest::setBenchmarkResult(static_cast<qreal>(latency),
+                              QTest::WalltimeNanoseconds);
+}
+
+void QMarkdownTextEditBenchmark::searchCount_data() {
+    QTest::addColumn<int>("searchMode");
+    QTest::addColumn<QString>("firstTerm");
+    QTest::addColumn<QString>("secondTerm");
+
+    QTest::newRow("plain text")
+        << int(QPlainTextEditSearchWidget::PlainTextMode)
+        << QStringLiteral("section") << QStringLiteral("value");
+    QTest::newRow("whole words")
+        << int(QPlainTextEditSearchWidget::WholeWordsMode)
+        << QStringLiteral("section") << QStringLiteral("value");
+    QTest::newRow("regular expression")
+        << int(QPlainTextEditSearchWidget::RegularExpressionMode)
+        << QStringLiteral("sect\\w+") << QStringLiteral("val\\w+");
+}
+
+/**
+ * Measures a search count in the large corpus
+ *
+ * The search terms are alternated, because the search matches of the last
+ * search get cached otherwise.
+ */
+void QMarkdownTextEditBenchmark::searchCount() {
+    QFETCH(int, searchMode);
+    QFETCH(QString, firstTerm);
+    QFETCH(QString, secondTerm);
+
+    QPlainTextEdit textEdit;
+    textEdit.setPlainText(largeCorpus());
+    QPlainTextEditSearchWidget searchWidget(&textEdit);
+
+    // the debounced search must not run on its own, there is no event loop
+    searchWidget.setDebounceDelay(24 * 60 * 60 * 1000);
+    searchWidget.setSearchMode(
+        static_cast<QPlainTextEditSearchWidget::SearchMode>(searchMode));
+    bool first = true;
+
+    QBENCHMARK {
+        searchWidget.setSearchText(first ? firstTerm : secondTerm);
+        searchWidget.doSearchCount();
+        searchWidget.completeSearch();
+        first = !first;
+    }
+}
+
+void QMarkdownTextEditBenchmark::scrollPaint_data() {
+    QTest::addColumn<QString>("text");
+
+    for (const QString &name : corpusNames()) {
+        QTest::newRow(name.toUtf8().constData()) << corpus(name);
+    }
+}
+
+/**
+ * Measures scrolling by a page and painting the viewport of the editor
+ */
+void QMarkdownTextEditBenchmark::scrollPaint() {
+    QFETCH(QString, text);
+
+    QMarkdownTextEdit textEdit;
+    textEdit.resize(800, 600);
+    textEdit.setPlainText(text);
+    textEdit.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&textEdit));
+
+    QScrollBar *scrollBar = textEdit.verticalScrollBar();
+
+    QBENCHMARK {
+        int value = scrollBar->value() + scrollBar->pageStep();
+        if (value > scrollBar->maximum()) value = 0;
+
+        scrollBar->setValue(value);
+        textEdit.viewport()->repaint();
+    }
+}
+
+void QMarkdownTextEditBenchmark::memoryUsage_data() { rehighlight_data(); }
+
+/**
+ * Reports the memory the highlighting of the document uses
+ */
+void QMarkdownTextEditBenchmark::memoryUsage() {
+    QFETCH(QString, text);
+
+    QTextDocument document(text);
+    MarkdownHighlighter highlighter(&document);
+    highlighter.rehighlight();
+
+    QTest::setBenchmarkResult(
+        static_cast<qreal>(highlighter.memoryUsage().total()),
+        QTest::BytesAllocated);
+}
+
+void QMarkdownTextEditBenchmark::bulkEdit_data() {
+    QTest::addColumn<int>("key");
+    QTest::addColumn<int>("modifiers");
+
+    QTest::newRow("indent") << int(Qt::Key_Tab) << int(Qt::NoModifier);
+    QTest::newRow("un-indent")
+        << int(Qt::Key_Backtab) << int(Qt::ShiftModifier);
+    QTest::newRow("move down")
+        << int(Qt::Key_Down) << int(Qt::ControlModifier | Qt::ShiftModifier);
+    QTest::newRow("duplicate")
+        << int(Qt::Key_Down) << int(Qt::ControlModifier | Qt::AltModifier);
+}
+
+/**
+ * Reports the median latency of indenting, un-indenting, moving and
+ * duplicating a selection of 20000 lines in the editor
+ */
+void QMarkdownTextEditBenchmark::bulkEdit() {
+    QFETCH(int, key);
+    QFETCH(int, modifiers);
+
+    QString text;
+    for (int i = 0; i < 20000; ++i) {
+        text += QStringLiteral("    - item %1 with *emphasis* and `code`\n")
+                    .arg(i);
+    }
+    // the selection is moved down across this line
+    text += QStringLiteral("last line");
+
+    QMarkdownTextEdit textEdit;
+    textEdit.resize(800, 600);
+    textEdit.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&textEdit));
+
+    const int runs = 10;
+    QVector<qint64> latencies;
+    latencies.reserve(runs);
+    QElapsedTimer timer;
+
+    for (int i = 0; i < runs; ++i) {
+        textEdit.setPlainText(text);
+
+        // select all lines but the last one
+        QTextCursor cursor = textEdit.textCursor();
+        cursor.setPosition(0);
+        cursor.setPosition(textEdit.document()->lastBlock().position() - 1,
+                           QTextCursor::KeepAnchor);
+        textEdit.setTextCursor(cursor);
+        QCoreApplication::processEvents();
+
+        timer.start();
+        QTest::keyClick(&textEdit, static_cast<Qt::Key>(key),
+                        Qt::KeyboardModifiers(QFlag(modifiers)));
+        latencies.append(timer.nsecsElapsed());
+    }
+
+    QTest::setBenchmarkResult(static_cast<qreal>(percentile(latencies, 50)),
+                              QTest::WalltimeNanoseconds);
+}
+
+int main(int argc, char *argv[]) {
+    // no display is needed to measure the painting
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QApplication app(argc, argv);
+    QMarkdownTextEditBenchmark benchmark;
+
+    return QTest::qExec(&benchmark, argc, argv);
+}
+
+#include "benchmark.moc"
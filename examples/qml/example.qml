@@ -9,14 +9,43 @@ Window {
     visible: true
     title: qsTr("QtQuick Project")
 
-    TextEdit {
-        id: editor
-        text: "# Hello world!"
-        focus: true
+    Flickable {
+        id: flickable
+        anchors.fill: parent
+        contentWidth: editor.paintedWidth
+        contentHeight: editor.paintedHeight
+        clip: true
+
+        // large texts are highlighted starting with the visible part
+        function updateVisibleRange() {
+            syntaxHighlighter.setVisiblePositionRange(
+                editor.positionAt(contentX, contentY),
+                editor.positionAt(contentX + width, contentY + height))
+        }
+
+        onContentYChanged: updateVisibleRange()
+        onHeightChanged: updateVisibleRange()
+
+        TextEdit {
+            id: editor
+            width: flickable.width
+            text: "# Hello world!"
+            focus: true
+            wrapMode: TextEdit.Wrap
+        }
+    }
+
+    Rectangle {
+        anchors.bottom: parent.bottom
+        height: 2
+        width: parent.width * syntaxHighlighter.progress
+        color: "steelblue"
+        visible: syntaxHighlighter.busy
     }
 
     MarkdownHighlighter {
         id: syntaxHighlighter
         textDocument: editor.textDocument
+        lazyHighlighting: true
     }
 }
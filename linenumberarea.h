@@ -4,7 +4,9 @@
 #include <QDebug>
 #include <QPainter>
 #include <QScrollBar>
+#include <QStaticText>
 #include <QWidget>
+#include <QtMath>
 
 #include "qmarkdowntextedit.h"
 
@@ -22,6 +24,8 @@ class LineNumArea final : public QWidget {
 
         // We always use fixed font to avoid "width" issues
         setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+        _currentBlockNumber = textEdit->textCursor().blockNumber();
     }
 
     void setCurrentLineColor(QColor color) { _currentLineColor = color; }
@@ -35,6 +39,44 @@ class LineNumArea final : public QWidget {
             return 0;
         }
 
+        if (_width < 0) {
+            _width = calculateLineNumAreaWidth();
+        }
+
+        return _width;
+    }
+
+    /**
+     * The width needs to be calculated again after the block count or the
+     * font of the text edit changed
+     */
+    void updateWidth() { _width = -1; }
+
+    /**
+     * Repaints only the rows of the previous and the new current line
+     */
+    void setCurrentBlockNumber(int blockNumber) {
+        if (blockNumber == _currentBlockNumber) {
+            return;
+        }
+
+        updateBlock(_currentBlockNumber);
+        _currentBlockNumber = blockNumber;
+        updateBlock(_currentBlockNumber);
+    }
+
+    bool isLineNumAreaEnabled() const { return enabled; }
+
+    void setLineNumAreaEnabled(bool e) {
+        enabled = e;
+        setHidden(!e);
+        updateWidth();
+    }
+
+    QSize sizeHint() const override { return {lineNumAreaWidth(), 0}; }
+
+   protected:
+    int calculateLineNumAreaWidth() const {
         int digits = 2;
         int max = std::max(1, textEdit->blockCount());
         while (max >= 10) {
@@ -53,16 +95,50 @@ class LineNumArea final : public QWidget {
         return space;
     }
 
-    bool isLineNumAreaEnabled() const { return enabled; }
+    void updateBlock(int blockNumber) {
+        if (!enabled || blockNumber < 0) {
+            return;
+        }
 
-    void setLineNumAreaEnabled(bool e) {
-        enabled = e;
-        setHidden(!e);
+        const QTextBlock block =
+            textEdit->document()->findBlockByNumber(blockNumber);
+        if (!block.isValid()) {
+            return;
+        }
+
+        const QRectF rect = textEdit->blockBoundingGeometry(block).translated(
+            textEdit->contentOffset());
+        const int top = qFloor(rect.top()) + textEdit->viewportMargins().top();
+        update(0, top, width(), qCeil(rect.height()) + 1);
     }
 
-    QSize sizeHint() const override { return {lineNumAreaWidth(), 0}; }
+    /**
+     * Prepares the glyphs of the digits, so the line numbers can be drawn
+     * without laying out their text
+     */
+    void prepareDigits() {
+        const QFontMetricsF metrics(font());
+#if QT_VERSION >= 0x050B00
+        _digitWidth = metrics.horizontalAdvance(QLatin1Char('0'));
+#else
+        _digitWidth = metrics.width(QLatin1Char('0'));
+#endif
+
+        for (int i = 0; i < 10; ++i) {
+            _digits[i].setText(QString(QLatin1Char(char('0' + i))));
+            _digits[i].setTextFormat(Qt::PlainText);
+            _digits[i].prepare(QTransform(), font());
+        }
+    }
+
+    void changeEvent(QEvent *event) override {
+        if (event->type() == QEvent::FontChange) {
+            _digitWidth = -1;
+        }
+
+        QWidget::changeEvent(event);
+    }
 
-   protected:
     void paintEvent(QPaintEvent *event) override {
         QPainter painter(this);
 
@@ -82,19 +158,28 @@ class LineNumArea final : public QWidget {
         const QPen otherLines = _otherLinesColor;
         painter.setFont(font());
 
+        if (_digitWidth < 0) {
+            prepareDigits();
+        }
+
+        const qreal right = lineNumAreaWidth() - 5;
+
         while (block.isValid() && top <= event->rect().bottom()) {
             top = bottom;
             bottom = top + textEdit->blockBoundingRect(block).height();
             if (block.isVisible() && bottom >= event->rect().top()) {
-                QString number = QString::number(blockNumber + 1);
-
-                auto isCurrentLine =
-                    textEdit->textCursor().blockNumber() == blockNumber;
+                auto isCurrentLine = _currentBlockNumber == blockNumber;
                 painter.setPen(isCurrentLine ? currentLine : otherLines);
 
-                painter.drawText(-5, top, sizeHint().width(),
-                                 textEdit->fontMetrics().height(),
-                                 Qt::AlignRight, number);
+                // draw the digits from right to left
+                qreal x = right;
+                int number = blockNumber + 1;
+                do {
+                    x -= _digitWidth;
+                    painter.drawStaticText(QPointF(x, top),
+                                           _digits[number % 10]);
+                    number /= 10;
+                } while (number > 0);
             }
 
             block = block.next();
@@ -107,6 +192,10 @@ class LineNumArea final : public QWidget {
     QMarkdownTextEdit *textEdit;
     QColor _currentLineColor;
     QColor _otherLinesColor;
+    mutable int _width = -1;
+    int _currentBlockNumber = -1;
+    qreal _digitWidth = -1;
+    QStaticText _digits[10];
 };
 
 #endif    // LINENUMBERAREA_H
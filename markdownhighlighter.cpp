@@ -28,12 +28,26 @@
 
 #include "markdownhighlighter.h"
 
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QRegularExpression>
 #include <QRegularExpressionMatch>
 #include <QRegularExpressionMatchIterator>
+#include <QRunnable>
+#include <QSemaphore>
 #include <QTextDocument>
+#include <QTextLayout>
+#include <QThreadPool>
 #include <QTimer>
+#include <QTextBlockUserData>
+#include <QWaitCondition>
+#include <algorithm>
+#include <limits>
 #include <utility>
 
 #include "qownlanguagedata.h"
@@ -47,12 +61,529 @@
 #define MH_SUBSTR(pos, len) QStringView(text).mid(pos, len)
 #endif
 
-QHash<QString, MarkdownHighlighter::HighlighterState>
-    MarkdownHighlighter::_langStringToEnum;
-QHash<MarkdownHighlighter::HighlighterState, QTextCharFormat>
-    MarkdownHighlighter::_formats;
-QVector<MarkdownHighlighter::HighlightingRule>
-    MarkdownHighlighter::_highlightingRules;
+#ifdef QMARKDOWNTEXTEDIT_INSTRUMENTATION
+namespace {
+
+/**
+ * Adds the time of its lifetime and the processed characters to statistics
+ */
+class PhaseTimer {
+   public:
+    PhaseTimer(MarkdownHighlighter::PhaseStatistics &statistics,
+               const QString &text)
+        : _statistics(statistics) {
+        ++_statistics.calls;
+        _statistics.characters += text.length();
+        _timer.start();
+    }
+    ~PhaseTimer() { _statistics.nsecs += _timer.nsecsElapsed(); }
+
+   private:
+    MarkdownHighlighter::PhaseStatistics &_statistics;
+    QElapsedTimer _timer;
+};
+
+}    // namespace
+
+#define MH_MEASURE_PHASE(phase, text) \
+    PhaseTimer phaseTimer(_statistics.phases[phase], text)
+#define MH_MEASURE_LANGUAGE(language, text) \
+    PhaseTimer languageTimer(_statistics.languages[language], text)
+#else
+#define MH_MEASURE_PHASE(phase, text)
+#define MH_MEASURE_LANGUAGE(language, text)
+#endif
+
+// identifies the serialized highlighting of a document and its format version
+static const quint32 stateMagic = 0x514d5453;
+static const quint32 stateVersion = 1;
+
+// the number of the slowest blocks kept by the instrumentation
+static const int maxSlowestBlocks = 10;
+
+// guards the default text formats and the default themes
+static QMutex defaultThemeMutex;
+
+// incremented every time the default text formats are changed, so
+// highlighters know when to pick up the new default theme
+static QAtomicInt defaultThemeGeneration;
+
+// guards the registration of languages and their names
+static QMutex registeredLanguageMutex;
+
+// the number of registered languages, they are only appended and published
+// by incrementing it, so the highlighting reads them without locking
+static QAtomicInt registeredLanguageTotal;
+
+// rules whose shouldContain literal is found in one pass over a line
+static const int maxPrefilteredRules = 64;
+
+// maximum number of cached bold and italic formats
+static const int maxEmphasisFormats = 64;
+
+// number of blocks that are highlighted synchronously in one go before the
+// rest of them is deferred to the lazy or asynchronous highlighting
+static const int syncBlockCount = 64;
+
+// number of blocks around the visible range of the editor that are
+// highlighted first
+static const int visibleMargin = 50;
+
+// milliseconds spent highlighting deferred blocks lazily per event loop
+// iteration
+static const int lazyChunkBudget = 10;
+
+// milliseconds a worker thread highlights before it publishes its results
+static const int asyncPublishInterval = 20;
+
+// minimum number of lines of the chunks that are lexed in parallel
+static const int minChunkLines = 512;
+
+// milliseconds spent applying asynchronous results per event loop iteration
+static const int asyncApplyBudget = 10;
+
+// milliseconds highlightingFinished() is delayed to coalesce the highlighting
+// of consecutive blocks and edits
+static const int highlightingFinishedDelay = 1000;
+
+static QEvent::Type asyncResultsEventType() {
+    static const int type = QEvent::registerEventType();
+    return static_cast<QEvent::Type>(type);
+}
+
+/**
+ * Inline ranges and cached properties of a block, they are stored as user
+ * data of the block, so they stay valid when blocks are inserted or removed
+ * in front of it and are renewed every time the block is highlighted
+ */
+struct MarkdownHighlighter::BlockData : public QTextBlockUserData {
+    BlockData(QVector<InlineRange> ranges, bool codeBlockFence_,
+              bool rightToLeft_);
+
+    bool find(RangeType type, int position, bool atBorder,
+              InlineRange *range = nullptr) const;
+    QVector<InlineRange> inlineRanges() const;
+    qint64 memoryUsage() const;
+
+    /**
+     * An inline range with the largest end of all ranges up to it, so the
+     * search for the ranges containing a position can stop early
+     */
+    template <typename Offset>
+    struct PackedRange {
+        Offset begin;
+        Offset end;
+        Offset maxEnd;
+        quint8 type;
+    };
+
+    template <typename Offset>
+    static void pack(const QVector<InlineRange> &ranges,
+                     QVector<PackedRange<Offset>> &packed);
+    template <typename Offset>
+    static bool find(const QVector<PackedRange<Offset>> &ranges,
+                     RangeType type, int position, bool atBorder,
+                     InlineRange *range);
+
+    // sorted by their begin, with 16 bit offsets for the (nearly all) blocks
+    // that are short enough, only one of them is used
+    QVector<PackedRange<quint16>> shortRanges;
+    QVector<PackedRange<qint32>> longRanges;
+    // reference definitions like "[1]: http://domain" as id and url
+    QVector<QPair<QString, QString>> references;
+    bool codeBlockFence;
+    bool rightToLeft;
+};
+
+/**
+ * Highlights a snapshot of the texts of consecutive blocks in a worker thread
+ */
+struct MarkdownHighlighter::AsyncJob : public QRunnable {
+    AsyncJob(MarkdownHighlighter *highlighter_,
+             HighlightingOptions highlightingOptions)
+        : highlighter(highlighter_),
+          lexer(LexerTag(), highlightingOptions) {
+        setAutoDelete(false);
+
+        // the theme is immutable, so it can be shared with the worker thread
+        lexer._theme = highlighter_->_theme;
+    }
+
+    void run() override;
+    void publish(QVector<BlockResult> &batch, bool last);
+
+    MarkdownHighlighter *highlighter;
+    MarkdownHighlighter lexer;
+    QVector<QString> texts;
+    QString previousText;
+    int firstBlockNumber = 0;
+    int previousState = NoState;
+    QAtomicInt cancelled;
+
+    // guarded by mutex
+    QMutex mutex;
+    QWaitCondition stopped;
+    QVector<BlockResult> results;
+    int nextBlockNumber = 0;
+    bool running = true;
+    bool finished = false;
+    bool eventPending = false;
+};
+
+void MarkdownHighlighter::AsyncJob::run() {
+    BlockContext context;
+    context.previousState = previousState;
+    QVector<BlockResult> batch;
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int i = 0; i < texts.size(); ++i) {
+        if (cancelled.loadAcquire()) break;
+
+        const QString &text = texts.at(i);
+        context.previousText = i > 0 ? texts.at(i - 1) : previousText;
+        context.nextText = i + 1 < texts.size() ? texts.at(i + 1) : QString();
+        context.isFirstBlock = firstBlockNumber + i == 0;
+
+        lexer.highlightBlockInContext(text, context);
+
+        BlockResult result;
+        result.blockNumber = firstBlockNumber + i;
+        result.text = text;
+        result.previousState = context.previousState;
+        result.state = context.state;
+        result.previousBlockState = context.previousBlockState;
+        formatRuns(context.formats, result.runs);
+        result.ranges.swap(context.ranges);
+        batch.append(result);
+
+        context.previousState = context.state;
+
+        if (timer.elapsed() >= asyncPublishInterval) {
+            publish(batch, false);
+            timer.restart();
+        }
+    }
+
+    publish(batch, true);
+
+    QMutexLocker locker(&mutex);
+    running = false;
+    stopped.wakeAll();
+}
+
+/**
+ * Hands the highlighted blocks over to the highlighter
+ */
+void MarkdownHighlighter::AsyncJob::publish(QVector<BlockResult> &batch,
+                                            bool last) {
+    QMutexLocker locker(&mutex);
+    if (cancelled.loadAcquire()) return;
+
+    nextBlockNumber += batch.size();
+    results += batch;
+    batch.clear();
+    finished = last;
+
+    if (!eventPending) {
+        eventPending = true;
+        QCoreApplication::postEvent(highlighter,
+                                    new QEvent(asyncResultsEventType()));
+    }
+}
+
+/**
+ * Lexes chunks of lines in a worker thread until all chunks are taken (see
+ * lexTexts())
+ */
+struct MarkdownHighlighter::ChunkWorker : public QRunnable {
+    struct Chunk {
+        const QStringList *lines;
+        BlockResult *results;
+        int begin;
+        int end;
+    };
+
+    ChunkWorker(HighlightingOptions highlightingOptions,
+                const ThemePointer &theme, const QVector<Chunk> &chunks_,
+                QAtomicInt &nextChunk_, QSemaphore &done_)
+        : lexer(LexerTag(), highlightingOptions),
+          chunks(chunks_),
+          nextChunk(nextChunk_),
+          done(done_) {
+        setAutoDelete(false);
+        lexer._theme = theme;
+    }
+
+    void run() override {
+        work();
+        done.release();
+    }
+
+    void work() {
+        // every chunk assumes that nothing is open at its start
+        for (int i = nextChunk.fetchAndAddOrdered(1); i < chunks.size();
+             i = nextChunk.fetchAndAddOrdered(1)) {
+            const Chunk &chunk = chunks.at(i);
+            lexer.lexLines(*chunk.lines, chunk.begin, chunk.end, NoState,
+                           chunk.results, false);
+        }
+    }
+
+    MarkdownHighlighter lexer;
+    const QVector<Chunk> &chunks;
+    QAtomicInt &nextChunk;
+    QSemaphore &done;
+};
+
+static bool isBlankLine(const QString &line) {
+    for (const QChar c : line) {
+        if (!c.isSpace()) return false;
+    }
+
+    return true;
+}
+
+/**
+ * Highlights the lines of texts in parallel, in the global thread pool and
+ * the calling thread
+ *
+ * The texts are split into chunks that start after blank lines, where most
+ * constructs end. The chunks are lexed speculatively at the same time,
+ * assuming that nothing is open at their start. Afterwards they are checked
+ * in order and only the chunks whose predecessor ends in another state (like
+ * inside of a code block) are lexed again, until their states match the
+ * speculative ones. So the results are the same as lexing the lines one after
+ * another.
+ *
+ * @param texts the lines of every text
+ * @param highlightingOptions
+ * @param theme
+ * @param results gets the highlighting of every line of every text
+ */
+void MarkdownHighlighter::lexTexts(const QVector<QStringList> &texts,
+                                   HighlightingOptions highlightingOptions,
+                                   const ThemePointer &theme,
+                                   QVector<QVector<BlockResult>> &results) {
+    results.resize(texts.size());
+
+    int lineCount = 0;
+    for (int i = 0; i < texts.size(); ++i) {
+        results[i].resize(texts.at(i).size());
+        lineCount += texts.at(i).size();
+    }
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    const int threadCount = qMax(1, pool->maxThreadCount());
+
+    // a few chunks per thread, so threads that are done early take over
+    // the chunks of the others
+    const int chunkLines =
+        qMax(minChunkLines, lineCount / (threadCount * 4) + 1);
+
+    QVector<ChunkWorker::Chunk> chunks;
+    for (int i = 0; i < texts.size(); ++i) {
+        const QStringList &lines = texts.at(i);
+        int begin = 0;
+
+        while (begin < lines.size()) {
+            int end = qMin(begin + chunkLines, lines.size());
+            while (end < lines.size() && !isBlankLine(lines.at(end - 1))) {
+                ++end;
+            }
+
+            const ChunkWorker::Chunk chunk = {&lines, results[i].data(), begin,
+                                              end};
+            chunks.append(chunk);
+            begin = end;
+        }
+    }
+
+    if (chunks.isEmpty()) return;
+
+    QAtomicInt nextChunk;
+    QSemaphore done;
+    QVector<ChunkWorker *> workers;
+    const int workerCount = qMin(threadCount + 1, chunks.size());
+    for (int i = 0; i < workerCount; ++i) {
+        workers.append(new ChunkWorker(highlightingOptions, theme, chunks,
+                                       nextChunk, done));
+    }
+
+    // the calling thread lexes chunks too
+    for (int i = 1; i < workers.size(); ++i) {
+        pool->start(workers.at(i));
+    }
+    workers.at(0)->work();
+
+    int running = workers.size() - 1;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    // workers that didn't start yet aren't needed anymore
+    for (int i = 1; i < workers.size(); ++i) {
+        if (pool->tryTake(workers.at(i))) --running;
+    }
+#endif
+    done.acquire(running);
+
+    // chunks that were lexed with the wrong state are lexed again
+    for (const ChunkWorker::Chunk &chunk : chunks) {
+        if (chunk.begin == 0) continue;
+
+        const int state = chunk.results[chunk.begin - 1].state;
+        if (state != chunk.results[chunk.begin].previousState) {
+            workers.at(0)->lexer.lexLines(*chunk.lines, chunk.begin,
+                                          chunk.end, state, chunk.results,
+                                          true);
+        }
+    }
+
+    qDeleteAll(workers);
+}
+
+/**
+ * Lexes the lines from begin to end, the results are stored at the line
+ * numbers
+ *
+ * @param lines
+ * @param begin
+ * @param end
+ * @param previousState the state of the line before begin
+ * @param results
+ * @param converge stops at the first line that starts with the state it
+ * already has in the results, because the rest of the results can't change
+ */
+void MarkdownHighlighter::lexLines(const QStringList &lines, int begin,
+                                   int end, int previousState,
+                                   BlockResult *results, bool converge) {
+    BlockContext context;
+    context.previousState = previousState;
+
+    for (int i = begin; i < end; ++i) {
+        BlockResult &result = results[i];
+        if (converge && i > begin &&
+            result.previousState == context.previousState) {
+            return;
+        }
+
+        context.previousText = i > 0 ? lines.at(i - 1) : QString();
+        context.nextText = i + 1 < lines.size() ? lines.at(i + 1) : QString();
+        context.isFirstBlock = i == 0;
+
+        highlightBlockInContext(lines.at(i), context);
+
+        result.blockNumber = i;
+        result.text = lines.at(i);
+        result.previousState = context.previousState;
+        result.state = context.state;
+        result.previousBlockState = context.previousBlockState;
+        formatRuns(context.formats, result.runs);
+        result.ranges.swap(context.ranges);
+
+        context.previousState = context.state;
+    }
+}
+
+/**
+ * Highlights the lines of a text in parallel, without a document
+ *
+ * @param lines
+ * @param highlightingOptions
+ * @param theme the default theme of the options is used if it is null
+ * @return the format runs of every line
+ */
+QVector<QVector<MarkdownHighlighter::FormatRun>>
+MarkdownHighlighter::highlightLines(const QStringList &lines,
+                                    HighlightingOptions highlightingOptions,
+                                    ThemePointer theme) {
+    if (!theme) theme = defaultTheme(highlightingOptions);
+
+    QVector<QVector<BlockResult>> results;
+    lexTexts(QVector<QStringList>(1, lines), highlightingOptions, theme,
+             results);
+
+    QVector<BlockResult> &lineResults = results[0];
+    QVector<QVector<FormatRun>> runs(lineResults.size());
+    for (int i = 0; i < lineResults.size(); ++i) {
+        runs[i].swap(lineResults[i].runs);
+    }
+
+    return runs;
+}
+
+/**
+ * Merges the per character formats to runs, the same way QSyntaxHighlighter
+ * applies them to the text layout
+ *
+ * @param formats
+ * @param runs gets the runs, its memory is reused
+ */
+void MarkdownHighlighter::formatRuns(const QVector<QTextCharFormat> &formats,
+                                     QVector<FormatRun> &runs) {
+    runs.clear();
+    const QTextCharFormat emptyFormat;
+    int i = 0;
+
+    while (i < formats.size()) {
+        while (i < formats.size() && formats.at(i) == emptyFormat) ++i;
+        if (i == formats.size()) break;
+
+        FormatRun run;
+        run.start = i;
+        run.format = formats.at(i);
+        while (i < formats.size() && formats.at(i) == run.format) ++i;
+        run.length = i - run.start;
+        runs.append(run);
+    }
+}
+
+/**
+ * Creates a lexer that uses a theme, or the default theme of the
+ * highlighting options
+ *
+ * @param highlightingOptions
+ * @param theme
+ */
+MarkdownHighlighter::Lexer::Lexer(HighlightingOptions highlightingOptions,
+                                  ThemePointer theme)
+    : _lexer(LexerTag(), highlightingOptions) {
+    _lexer._theme =
+        theme ? std::move(theme) : defaultTheme(highlightingOptions);
+}
+
+/**
+ * Starts highlighting another text
+ */
+void MarkdownHighlighter::Lexer::reset() {
+    _context.previousText.clear();
+    _context.previousState = NoState;
+    _firstLine = true;
+}
+
+/**
+ * Highlights the next line of the text, without allocating memory once
+ * the buffers grew big enough for the lines
+ *
+ * @param line
+ * @param nextLine the line after it (setext headings look ahead one line)
+ * @param runs gets the format runs of the line, its memory is reused
+ * @return the state at the end of the line
+ */
+int MarkdownHighlighter::Lexer::highlightLine(const QString &line,
+                                              const QString &nextLine,
+                                              QVector<FormatRun> &runs) {
+    _context.nextText = nextLine;
+    _context.isFirstBlock = _firstLine;
+
+    _lexer.highlightBlockInContext(line, _context);
+    formatRuns(_context.formats, runs);
+
+    // the next line continues with this line
+    _context.previousText = line;
+    _context.previousState = _context.state;
+    _firstLine = false;
+
+    return _context.state;
+}
 
 /**
  * Markdown syntax highlighting
@@ -64,42 +595,94 @@ MarkdownHighlighter::MarkdownHighlighter(
     : QSyntaxHighlighter(parent), _highlightingOptions(highlightingOptions) {
     // _highlightingOptions = highlightingOptions;
     _timer = new QTimer(this);
+    _timer->setSingleShot(true);
     connect(_timer, &QTimer::timeout, this, &MarkdownHighlighter::timerTick);
 
-    _timer->start(1000);
-
-    // initialize the highlighting rules
-    initHighlightingRules();
+    // use the shared highlighting rules and text formats
+    updateTheme();
+}
 
-    // initialize the text formats
-    initTextFormats();
+/**
+ * Creates a highlighter that isn't attached to a document and is only used
+ * to highlight BlockContexts
+ */
+MarkdownHighlighter::MarkdownHighlighter(
+    LexerTag, HighlightingOptions highlightingOptions)
+    : QSyntaxHighlighter(static_cast<QTextDocument *>(nullptr)),
+      _highlightingOptions(highlightingOptions) {}
 
-    // initialize code languages
-    initCodeLangs();
-}
+MarkdownHighlighter::~MarkdownHighlighter() { stopAsyncHighlighting(); }
 
 /**
- * Does jobs every second
+ * Does the jobs scheduled with scheduleTimerTick()
  */
 void MarkdownHighlighter::timerTick() {
-    // re-highlight all dirty blocks
-    reHighlightDirtyBlocks();
+    // re-highlight all dirty blocks and delay the signal until the
+    // highlighting has settled
+    if (!_dirtyTextBlocks.isEmpty()) {
+        reHighlightDirtyBlocks();
 
-    // emit a signal every second if there was some highlighting done
+        if (_highlightingFinished) {
+            _timer->start(highlightingFinishedDelay);
+        }
+
+        return;
+    }
+
+    // emit a signal (at most every second) if there was some highlighting
+    // done
     if (_highlightingFinished) {
         _highlightingFinished = false;
         Q_EMIT highlightingFinished();
     }
 }
 
+/**
+ * Arms the timer for timerTick(), unless it is armed to fire earlier
+ * anyway, so idle highlighters don't cause any wakeups
+ *
+ * @param msec
+ */
+void MarkdownHighlighter::scheduleTimerTick(int msec) {
+    if (!_timer) return;
+    if (_timer->isActive() && _timer->remainingTime() <= msec) return;
+
+    _timer->start(msec);
+}
+
+/**
+ * Remembers that there was some highlighting done, highlightingFinished()
+ * will be emitted with the next timerTick()
+ */
+void MarkdownHighlighter::markHighlightingFinished() {
+    if (_highlightingFinished) return;
+
+    _highlightingFinished = true;
+    scheduleTimerTick(highlightingFinishedDelay);
+}
+
 /**
  * Re-highlights all dirty blocks
  */
 void MarkdownHighlighter::reHighlightDirtyBlocks() {
-    while (_dirtyTextBlocks.count() > 0) {
-        QTextBlock block = _dirtyTextBlocks.at(0);
-        rehighlightBlock(block);
-        _dirtyTextBlocks.removeFirst();
+    while (!_dirtyTextBlocks.isEmpty()) {
+        // re-highlighting may mark more blocks dirty, they are done next
+        QVector<QTextBlock> blocks;
+        blocks.swap(_dirtyTextBlocks);
+
+        // the positions may have changed since the blocks were added
+        std::sort(blocks.begin(), blocks.end(),
+                  [](const QTextBlock &a, const QTextBlock &b) {
+                      return a.position() < b.position();
+                  });
+
+        for (int i = 0; i < blocks.size(); ++i) {
+            const QTextBlock &block = blocks.at(i);
+            if (!block.isValid() || (i > 0 && block == blocks.at(i - 1)))
+                continue;
+
+            rehighlightBlock(block);
+        }
     }
 }
 
@@ -107,41 +690,71 @@ void MarkdownHighlighter::reHighlightDirtyBlocks() {
  * Clears the dirty blocks vector
  */
 void MarkdownHighlighter::clearDirtyBlocks() {
-    _ranges.clear();
+    stopAsyncHighlighting();
+    _asyncResults.clear();
+    clearDeferredBlocks();
+
     _dirtyTextBlocks.clear();
+    scheduleProgressUpdate();
 }
 
 /**
- * Adds a dirty block to the list if it doesn't already exist
+ * Adds a dirty block to the list, duplicates are skipped when re-highlighting
  *
  * @param block
  */
 void MarkdownHighlighter::addDirtyBlock(const QTextBlock &block) {
-    if (!_dirtyTextBlocks.contains(block)) {
-        _dirtyTextBlocks.append(block);
-    }
+    if (!block.isValid()) return;
+
+    _dirtyTextBlocks.append(block);
+
+    // the block must not be re-highlighted directly, that would crash
+    // QSyntaxHighlighter
+    scheduleTimerTick(0);
+}
+
+/**
+ * Initializes the highlighting rules by using the shared default theme for
+ * the current highlighting options
+ */
+void MarkdownHighlighter::initHighlightingRules() {
+    if (_customTheme) return;
+
+    _themeGeneration = defaultThemeGeneration.loadAcquire();
+    ThemePointer theme = defaultTheme(_highlightingOptions);
+
+    // the cached documents were highlighted with the formats of the old theme
+    if (theme != _theme) _stateCache.clear();
+    _theme = std::move(theme);
 }
 
 /**
- * Initializes the highlighting rules
+ * Creates the highlighting rules for some highlighting options
  *
  * regexp tester:
  * https://regex101.com
  *
  * other examples:
  * /usr/share/kde4/apps/katepart/syntax/markdown.xml
+ *
+ * @param highlightingOptions
+ * @return
  */
-void MarkdownHighlighter::initHighlightingRules() {
+QVector<MarkdownHighlighter::HighlightingRule>
+MarkdownHighlighter::createHighlightingRules(
+    HighlightingOptions highlightingOptions) {
+    QVector<HighlightingRule> highlightingRules;
+
     // highlight block quotes
     {
         HighlightingRule rule(HighlighterState::BlockQuote);
         rule.pattern = QRegularExpression(
-            _highlightingOptions.testFlag(
+            highlightingOptions.testFlag(
                 HighlightingOption::FullyHighlightedBlockQuote)
                 ? QStringLiteral("^\\s*(>\\s*.+)")
                 : QStringLiteral("^\\s*(>\\s*)+"));
         rule.shouldContain = QStringLiteral("> ");
-        _highlightingRules.append(rule);
+        highlightingRules.append(rule);
     }
 
     // highlight tables without starting |
@@ -156,7 +769,7 @@ void MarkdownHighlighter::initHighlightingRules() {
         rule.pattern = QRegularExpression(QStringLiteral("( +)$"));
         rule.shouldContain = QStringLiteral("  ");
         rule.capturingGroup = 1;
-        _highlightingRules.append(rule);
+        highlightingRules.append(rule);
     }
 
     // highlight inline comments
@@ -166,255 +779,1685 @@ void MarkdownHighlighter::initHighlightingRules() {
         rule.pattern =
             QRegularExpression(QStringLiteral(R"(^\[.+?\]: # \(.+?\)$)"));
         rule.shouldContain = QStringLiteral("]: # (");
-        _highlightingRules.append(rule);
+        highlightingRules.append(rule);
+    }
+
+    // highlight tables with starting |
+    {
+        HighlightingRule rule(HighlighterState::Table);
+        rule.shouldContain = QStringLiteral("|");
+        // Support up to 3 leading spaces, because md4c seems to support it
+        // See https://github.com/pbek/QOwnNotes/issues/3137
+        rule.pattern =
+            QRegularExpression(QStringLiteral("^\\s{0,3}(\\|.+?\\|)$"));
+        rule.capturingGroup = 1;
+        highlightingRules.append(rule);
+    }
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 4, 0)
+    // compile the patterns up front instead of on their first match
+    for (HighlightingRule &rule : highlightingRules) {
+        rule.pattern.optimize();
+    }
+#endif
+
+    return highlightingRules;
+}
+
+/**
+ * Creates the default text formats
+ *
+ * @param defaultFontSize
+ * @return
+ */
+QHash<MarkdownHighlighter::HighlighterState, QTextCharFormat>
+MarkdownHighlighter::createTextFormats(int defaultFontSize) {
+    QHash<HighlighterState, QTextCharFormat> formats;
+    QTextCharFormat format;
+
+    // set character formats for headlines
+    format = QTextCharFormat();
+    format.setForeground(QColor(2, 69, 150));
+    format.setFontWeight(QFont::Bold);
+    format.setFontPointSize(defaultFontSize * 1.6);
+    formats[H1] = format;
+    format.setFontPointSize(defaultFontSize * 1.5);
+    formats[H2] = format;
+    format.setFontPointSize(defaultFontSize * 1.4);
+    formats[H3] = format;
+    format.setFontPointSize(defaultFontSize * 1.3);
+    formats[H4] = format;
+    format.setFontPointSize(defaultFontSize * 1.2);
+    formats[H5] = format;
+    format.setFontPointSize(defaultFontSize * 1.1);
+    formats[H6] = format;
+    format.setFontPointSize(defaultFontSize);
+
+    // set character format for horizontal rulers
+    format = QTextCharFormat();
+    format.setForeground(Qt::darkGray);
+    format.setBackground(Qt::lightGray);
+    formats[HorizontalRuler] = std::move(format);
+
+    // set character format for lists
+    format = QTextCharFormat();
+    format.setForeground(QColor(163, 0, 123));
+    formats[List] = format;
+
+    // set character format for checkbox
+    format = QTextCharFormat();
+    format.setForeground(QColor(123, 100, 223));
+    formats[CheckBoxUnChecked] = std::move(format);
+    // set character format for checked checkbox
+    format = QTextCharFormat();
+    format.setForeground(QColor(223, 50, 123));
+    formats[CheckBoxChecked] = std::move(format);
+
+    // set character format for links
+    format = QTextCharFormat();
+    format.setForeground(QColor(0, 128, 255));
+    format.setFontUnderline(true);
+    formats[Link] = std::move(format);
+
+    // set character format for images
+    format = QTextCharFormat();
+    format.setForeground(QColor(0, 191, 0));
+    format.setBackground(QColor(228, 255, 228));
+    formats[Image] = std::move(format);
+
+    // set character format for code blocks
+    format = QTextCharFormat();
+    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    // format.setBackground(QColor(220, 220, 220));
+    formats[CodeBlock] = format;
+    formats[InlineCodeBlock] = format;
+
+    // set character format for italic
+    format = QTextCharFormat();
+    format.setFontWeight(QFont::StyleItalic);
+    format.setFontItalic(true);
+    formats[Italic] = std::move(format);
+
+    // set character format for underline
+    format = QTextCharFormat();
+    format.setFontUnderline(true);
+    formats[StUnderline] = std::move(format);
+
+    // set character format for bold
+    format = QTextCharFormat();
+    format.setFontWeight(QFont::Bold);
+    formats[Bold] = std::move(format);
+
+    // set character format for comments
+    format = QTextCharFormat();
+    format.setForeground(QBrush(Qt::gray));
+    formats[Comment] = std::move(format);
+
+    // set character format for masked syntax
+    format = QTextCharFormat();
+    format.setForeground(QColor(204, 204, 204));
+    formats[MaskedSyntax] = std::move(format);
+
+    // set character format for tables
+    format = QTextCharFormat();
+    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    format.setForeground(QColor(100, 148, 73));
+    formats[Table] = std::move(format);
+
+    // set character format for block quotes
+    format = QTextCharFormat();
+    format.setForeground(Qt::darkRed);
+    formats[BlockQuote] = std::move(format);
+
+    format = QTextCharFormat();
+    formats[HeadlineEnd] = std::move(format);
+    formats[NoState] = std::move(format);
+
+    // set character format for trailing spaces
+    format.setBackground(QColor(252, 175, 62));
+    formats[TrailingSpace] = std::move(format);
+
+    /****************************************
+     * Formats for syntax highlighting
+     ***************************************/
+
+    format = QTextCharFormat();
+    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    format.setForeground(QColor(249, 38, 114));
+    formats[CodeKeyWord] = std::move(format);
+
+    format = QTextCharFormat();
+    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    format.setForeground(QColor(163, 155, 78));
+    formats[CodeString] = std::move(format);
+
+    format = QTextCharFormat();
+    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    format.setForeground(QColor(117, 113, 94));
+    formats[CodeComment] = std::move(format);
+
+    format = QTextCharFormat();
+    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    format.setForeground(QColor(84, 174, 191));
+    formats[CodeType] = std::move(format);
+
+    format = QTextCharFormat();
+    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    format.setForeground(QColor(219, 135, 68));
+    formats[CodeOther] = std::move(format);
+
+    format = QTextCharFormat();
+    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    format.setForeground(QColor(174, 129, 255));
+    formats[CodeNumLiteral] = std::move(format);
+
+    format = QTextCharFormat();
+    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    format.setForeground(QColor(1, 138, 15));
+    formats[CodeBuiltIn] = std::move(format);
+
+    return formats;
+}
+
+/**
+ * @brief creates the langStringToEnum
+ */
+QHash<QString, MarkdownHighlighter::HighlighterState>
+MarkdownHighlighter::createCodeLangs() {
+    return QHash<QString, MarkdownHighlighter::HighlighterState>{
+            {QLatin1String("bash"), MarkdownHighlighter::CodeBash},
+            {QLatin1String("c"), MarkdownHighlighter::CodeC},
+            {QLatin1String("cpp"), MarkdownHighlighter::CodeCpp},
+            {QLatin1String("cxx"), MarkdownHighlighter::CodeCpp},
+            {QLatin1String("c++"), MarkdownHighlighter::CodeCpp},
+            {QLatin1String("c#"), MarkdownHighlighter::CodeCSharp},
+            {QLatin1String("cmake"), MarkdownHighlighter::CodeCMake},
+            {QLatin1String("csharp"), MarkdownHighlighter::CodeCSharp},
+            {QLatin1String("css"), MarkdownHighlighter::CodeCSS},
+            {QLatin1String("go"), MarkdownHighlighter::CodeGo},
+            {QLatin1String("html"), MarkdownHighlighter::CodeXML},
+            {QLatin1String("ini"), MarkdownHighlighter::CodeINI},
+            {QLatin1String("java"), MarkdownHighlighter::CodeJava},
+            {QLatin1String("javascript"), MarkdownHighlighter::CodeJava},
+            {QLatin1String("js"), MarkdownHighlighter::CodeJs},
+            {QLatin1String("json"), MarkdownHighlighter::CodeJSON},
+            {QLatin1String("make"), MarkdownHighlighter::CodeMake},
+            {QLatin1String("nix"), MarkdownHighlighter::CodeNix},
+            {QLatin1String("php"), MarkdownHighlighter::CodePHP},
+            {QLatin1String("py"), MarkdownHighlighter::CodePython},
+            {QLatin1String("python"), MarkdownHighlighter::CodePython},
+            {QLatin1String("qml"), MarkdownHighlighter::CodeQML},
+            {QLatin1String("rust"), MarkdownHighlighter::CodeRust},
+            {QLatin1String("sh"), MarkdownHighlighter::CodeBash},
+            {QLatin1String("sql"), MarkdownHighlighter::CodeSQL},
+            {QLatin1String("taggerscript"),
+             MarkdownHighlighter::CodeTaggerScript},
+            {QLatin1String("ts"), MarkdownHighlighter::CodeTypeScript},
+            {QLatin1String("typescript"), MarkdownHighlighter::CodeTypeScript},
+            {QLatin1String("v"), MarkdownHighlighter::CodeV},
+            {QLatin1String("vex"), MarkdownHighlighter::CodeVex},
+            {QLatin1String("xml"), MarkdownHighlighter::CodeXML},
+            {QLatin1String("yml"), MarkdownHighlighter::CodeYAML},
+            {QLatin1String("yaml"), MarkdownHighlighter::CodeYAML},
+            {QLatin1String("forth"), MarkdownHighlighter::CodeForth},
+            {QLatin1String("systemverilog"),
+             MarkdownHighlighter::CodeSystemVerilog},
+            {QLatin1String("gdscript"), MarkdownHighlighter::CodeGDScript},
+            {QLatin1String("toml"), MarkdownHighlighter::CodeTOML},
+        };
+}
+
+/**
+ * Returns the default text formats, they are created on first use
+ */
+static QHash<MarkdownHighlighter::HighlighterState, QTextCharFormat>
+    &defaultTextFormats() {
+    static QHash<MarkdownHighlighter::HighlighterState, QTextCharFormat>
+        formats;
+    return formats;
+}
+
+/**
+ * Returns the default themes by their highlighting options
+ */
+static QHash<int, MarkdownHighlighter::ThemePointer> &defaultThemes() {
+    static QHash<int, MarkdownHighlighter::ThemePointer> themes;
+    return themes;
+}
+
+/**
+ * Sets the default text formats, that are used by all highlighters without
+ * a custom theme
+ *
+ * @param formats
+ */
+void MarkdownHighlighter::setTextFormats(
+    QHash<HighlighterState, QTextCharFormat> formats) {
+    QMutexLocker locker(&defaultThemeMutex);
+    defaultTextFormats() = std::move(formats);
+    defaultThemes().clear();
+    defaultThemeGeneration.ref();
+}
+
+/**
+ * Sets a default text format, that is used by all highlighters without a
+ * custom theme
+ *
+ * @param formats
+ */
+void MarkdownHighlighter::setTextFormat(HighlighterState state,
+                                        QTextCharFormat format) {
+    QMutexLocker locker(&defaultThemeMutex);
+    auto &formats = defaultTextFormats();
+    if (formats.isEmpty()) formats = createTextFormats();
+    formats[state] = std::move(format);
+    defaultThemes().clear();
+    defaultThemeGeneration.ref();
+}
+
+/**
+ * Creates an immutable theme, that can be shared by many highlighters
+ *
+ * @param formats
+ * @param highlightingOptions
+ * @return
+ */
+MarkdownHighlighter::ThemePointer MarkdownHighlighter::createTheme(
+    QHash<HighlighterState, QTextCharFormat> formats,
+    HighlightingOptions highlightingOptions) {
+    QSharedPointer<Theme> theme(new Theme);
+    theme->formats = std::move(formats);
+    theme->formatTable.resize(formatCount);
+    for (auto it = theme->formats.constBegin(); it != theme->formats.constEnd();
+         ++it) {
+        const int index = formatIndex(it.key());
+
+        // the last format stays empty for the states without a format
+        if (index != formatCount - 1) theme->formatTable[index] = it.value();
+    }
+
+    theme->highlightingRules = createHighlightingRules(highlightingOptions);
+    theme->langStringToEnum = createCodeLangs();
+    return theme;
+}
+
+/**
+ * Returns the theme with the default text formats for some highlighting
+ * options, it is only created once and then shared by all highlighters
+ *
+ * @param highlightingOptions
+ * @return
+ */
+MarkdownHighlighter::ThemePointer MarkdownHighlighter::defaultTheme(
+    HighlightingOptions highlightingOptions) {
+    QMutexLocker locker(&defaultThemeMutex);
+    ThemePointer &theme = defaultThemes()[int(highlightingOptions)];
+
+    if (!theme) {
+        auto &formats = defaultTextFormats();
+        if (formats.isEmpty()) formats = createTextFormats();
+        theme = createTheme(formats, highlightingOptions);
+    }
+
+    return theme;
+}
+
+/**
+ * Returns the names of the registered languages with their states
+ */
+static QHash<QString, int> &registeredLanguageNames() {
+    static QHash<QString, int> names;
+    return names;
+}
+
+/**
+ * Registers a language for fenced code blocks, that is highlighted like the
+ * built-in languages with the words of its LanguageData
+ *
+ * The states of the registered languages depend on the order of the
+ * registration, so languages should be registered at startup, before any
+ * text is highlighted or a saved document state is restored. The built-in
+ * languages take precedence over registered languages with the same names.
+ *
+ * @param names the names after the code fence, e.g. "lua"
+ * @param loader returns the words of the language, it's called whenever
+ * a line of the language is highlighted, so it should return a static
+ * instance that is built on first use (like loadCppData())
+ * @param lineComment the character that starts a line comment, if it is
+ * null C style comments are highlighted instead
+ * @return the state of the code blocks of the language, or NoState if no
+ * more languages can be registered
+ */
+MarkdownHighlighter::HighlighterState MarkdownHighlighter::registerLanguage(
+    const QStringList &names, LanguageLoader loader, QChar lineComment) {
+    if (!loader || names.isEmpty()) return NoState;
+
+    QMutexLocker locker(&registeredLanguageMutex);
+    const int index = registeredLanguageTotal.loadAcquire();
+    if (index >= registeredLanguageCount) return NoState;
+
+    RegisteredLanguage &language = registeredLanguages()[index];
+    language.loader = loader;
+    language.lineComment = lineComment;
+
+    const int state = firstRegisteredLanguageState + 2 * index;
+    auto &languageNames = registeredLanguageNames();
+    for (const QString &name : names) languageNames[name.toLower()] = state;
+
+    registeredLanguageTotal.storeRelease(index + 1);
+    return static_cast<HighlighterState>(state);
+}
+
+/**
+ * Returns the storage of the registered languages, by their index
+ */
+MarkdownHighlighter::RegisteredLanguage *
+MarkdownHighlighter::registeredLanguages() {
+    static RegisteredLanguage languages[registeredLanguageCount];
+    return languages;
+}
+
+/**
+ * Returns the registered language of a code block state, or nullptr if the
+ * state doesn't belong to a registered language
+ */
+const MarkdownHighlighter::RegisteredLanguage *
+MarkdownHighlighter::registeredLanguage(const int state) {
+    const int index =
+        (languageState(state) - firstRegisteredLanguageState) / 2;
+    if (languageState(state) < firstRegisteredLanguageState ||
+        index >= registeredLanguageTotal.loadAcquire())
+        return nullptr;
+    return &registeredLanguages()[index];
+}
+
+/**
+ * Returns the state of a registered language by one of its names in lower
+ * case, or NoState if there is none
+ */
+MarkdownHighlighter::HighlighterState
+MarkdownHighlighter::registeredLanguageState(const QString &name) {
+    if (registeredLanguageTotal.loadAcquire() == 0) return NoState;
+
+    QMutexLocker locker(&registeredLanguageMutex);
+    return static_cast<HighlighterState>(
+        registeredLanguageNames().value(name, NoState));
+}
+
+/**
+ * Sets a custom theme, a null theme switches back to the default theme
+ *
+ * The highlighting isn't redone, call rehighlight() for that.
+ *
+ * @param theme
+ */
+void MarkdownHighlighter::setTheme(ThemePointer theme) {
+    _customTheme = !theme.isNull();
+
+    if (_customTheme) {
+        if (theme != _theme) _stateCache.clear();
+        _theme = std::move(theme);
+    } else {
+        initHighlightingRules();
+    }
+}
+
+/**
+ * Picks up the current default theme, if the default text formats were
+ * changed in the meantime
+ */
+void MarkdownHighlighter::updateTheme() {
+    if (_customTheme ||
+        (_theme && _themeGeneration == defaultThemeGeneration.loadAcquire())) {
+        return;
+    }
+
+    initHighlightingRules();
+}
+
+/**
+ * Does the Markdown highlighting
+ *
+ * @param text
+ */
+void MarkdownHighlighter::highlightBlock(const QString &text) {
+    updateTheme();
+
+    const int blockState = currentBlockState();
+
+    setCurrentBlockState(HighlighterState::NoState);
+    currentBlock().setUserState(HighlighterState::NoState);
+
+    if (highlightBlockDeferred(text, blockState)) return;
+
+#ifdef QMARKDOWNTEXTEDIT_INSTRUMENTATION
+    QElapsedTimer blockTimer;
+    blockTimer.start();
+#endif
+
+    _blockRanges.clear();
+    highlightMarkdown(text);
+    setCurrentBlockData(text, _blockRanges);
+    updateSetextHeadingBlocks(blockState);
+
+#ifdef QMARKDOWNTEXTEDIT_INSTRUMENTATION
+    addBlockStatistics(text.length(), blockTimer.nsecsElapsed());
+#endif
+
+    markHighlightingFinished();
+}
+
+/**
+ * Queues the neighbours of the current block for re-highlighting, if they
+ * were highlighted as part of a setext heading together with the current
+ * block and that isn't the case anymore
+ *
+ * A setext heading only looks one block ahead and one block behind, so
+ * only these two blocks need to be checked. QSyntaxHighlighter already
+ * highlights the next block if the state of the current block changed.
+ *
+ * @param blockState the state the block had before it got highlighted
+ */
+void MarkdownHighlighter::updateSetextHeadingBlocks(int blockState) {
+    const int state = currentBlockState();
+
+    // the previous block is a heading because of this block, if this block
+    // still is a heading underline highlightSubHeadline() takes care of it
+    if (blockState == HeadlineEnd && state != HeadlineEnd) {
+        QTextBlock previousBlock = currentBlock().previous();
+        previousBlock.setUserState(NoState);
+        addDirtyBlock(previousBlock);
+    }
+
+    // the next block underlines this block, but this block isn't a heading
+    // (like a paragraph) anymore
+    if (state == blockState && state != H1 && state != H2) {
+        const QTextBlock nextBlock = currentBlock().next();
+        if (nextBlock.userState() == HeadlineEnd) addDirtyBlock(nextBlock);
+    }
+}
+
+/**
+ * Returns true if the library was built with the instrumentation
+ * (QMARKDOWNTEXTEDIT_INSTRUMENTATION), otherwise statistics() stays empty
+ */
+bool MarkdownHighlighter::instrumentationEnabled() {
+#ifdef QMARKDOWNTEXTEDIT_INSTRUMENTATION
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Resets the statistics of the instrumentation
+ */
+void MarkdownHighlighter::resetStatistics() { _statistics = Statistics(); }
+
+/**
+ * Adds the highlighting time of the current block to the statistics
+ *
+ * @param length
+ * @param nsecs
+ */
+void MarkdownHighlighter::addBlockStatistics(int length, qint64 nsecs) {
+    ++_statistics.blocks.calls;
+    _statistics.blocks.characters += length;
+    _statistics.blocks.nsecs += nsecs;
+
+    QVector<BlockStatistics> &slowestBlocks = _statistics.slowestBlocks;
+    const int blockNumber = currentBlock().blockNumber();
+
+    // a block is only listed once, with its slowest highlighting
+    for (int i = 0; i < slowestBlocks.size(); ++i) {
+        if (slowestBlocks.at(i).blockNumber != blockNumber) continue;
+        if (slowestBlocks.at(i).nsecs >= nsecs) return;
+
+        slowestBlocks.remove(i);
+        break;
+    }
+
+    if (slowestBlocks.size() == maxSlowestBlocks &&
+        slowestBlocks.constLast().nsecs >= nsecs) {
+        return;
+    }
+
+    BlockStatistics block;
+    block.blockNumber = blockNumber;
+    block.length = length;
+    block.nsecs = nsecs;
+
+    const auto it = std::upper_bound(
+        slowestBlocks.begin(), slowestBlocks.end(), nsecs,
+        [](qint64 value, const BlockStatistics &b) { return value > b.nsecs; });
+    slowestBlocks.insert(it, block);
+
+    if (slowestBlocks.size() > maxSlowestBlocks) slowestBlocks.removeLast();
+}
+
+/******************************
+ *  BLOCK ACCESS FUNCTIONS
+ ******************************/
+
+void MarkdownHighlighter::setFormat(int start, int count,
+                                    const QTextCharFormat &format) {
+    if (!_context) {
+        QSyntaxHighlighter::setFormat(start, count, format);
+        return;
+    }
+
+    QVector<QTextCharFormat> &formats = _context->formats;
+    if (start < 0 || start >= formats.size()) return;
+
+    const int end = qMin(start + count, formats.size());
+    for (int i = start; i < end; ++i) formats[i] = format;
+}
+
+QTextCharFormat MarkdownHighlighter::format(int position) const {
+    if (!_context) return QSyntaxHighlighter::format(position);
+
+    if (position < 0 || position >= _context->formats.size()) {
+        return QTextCharFormat();
+    }
+
+    return _context->formats.at(position);
+}
+
+int MarkdownHighlighter::currentBlockState() const {
+    return _context ? _context->state
+                    : QSyntaxHighlighter::currentBlockState();
+}
+
+void MarkdownHighlighter::setCurrentBlockState(int newState) {
+    if (_context) {
+        _context->state = newState;
+    } else {
+        QSyntaxHighlighter::setCurrentBlockState(newState);
+    }
+}
+
+int MarkdownHighlighter::previousBlockState() const {
+    return _context ? _context->previousState
+                    : QSyntaxHighlighter::previousBlockState();
+}
+
+QString MarkdownHighlighter::previousBlockText() const {
+    return _context ? _context->previousText
+                    : currentBlock().previous().text();
+}
+
+QString MarkdownHighlighter::nextBlockText() const {
+    return _context ? _context->nextText : currentBlock().next().text();
+}
+
+bool MarkdownHighlighter::isFirstBlock() const {
+    return _context ? _context->isFirstBlock
+                    : !currentBlock().previous().isValid();
+}
+
+QVector<MarkdownHighlighter::InlineRange> &
+MarkdownHighlighter::currentBlockRanges() {
+    return _context ? _context->ranges : _blockRanges;
+}
+
+/**
+ * Sets the user state of the previous block and queues it for
+ * re-highlighting
+ *
+ * @param state
+ */
+void MarkdownHighlighter::markPreviousBlockDirty(int state) {
+    if (_context) {
+        _context->previousBlockState = state;
+        return;
+    }
+
+    QTextBlock previousBlock = currentBlock().previous();
+    addDirtyBlock(previousBlock);
+    previousBlock.setUserState(state);
+}
+
+/******************************
+ *  DEFERRED HIGHLIGHTING
+ ******************************/
+
+/**
+ * Enables or disables the asynchronous highlighting
+ *
+ * If enabled, large amounts of blocks (like when loading a document) are
+ * highlighted in a worker thread and only the resulting formats are applied
+ * in the main thread, block by block
+ *
+ * @param enabled
+ */
+void MarkdownHighlighter::setAsyncHighlightingEnabled(bool enabled) {
+    if (_asyncHighlightingEnabled == enabled) return;
+
+    _asyncHighlightingEnabled = enabled;
+
+    if (enabled) {
+        if (!_deferredFrom.isNull()) scheduleDeferredHighlighting();
+        return;
+    }
+
+    // the blocks the worker thread didn't deliver yet, and the ones that
+    // weren't applied yet need to be highlighted in another way
+    int from = stopAsyncHighlighting();
+    if (!_asyncResults.isEmpty()) {
+        const int firstResult = _asyncResults.firstKey();
+        from = from == -1 ? firstResult : qMin(from, firstResult);
+    }
+    _asyncResults.clear();
+
+    if (from != -1 && document()) {
+        deferBlocks(document()->findBlockByNumber(from),
+                    document()->lastBlock());
+        processDeferredBlocks();
+    }
+}
+
+/**
+ * Enables or disables the lazy highlighting
+ *
+ * If enabled, large amounts of blocks (like when loading a document) are
+ * highlighted in small time slices when the application is idle, the
+ * visible blocks (see setVisibleBlockRange()) are highlighted first
+ *
+ * @param enabled
+ */
+void MarkdownHighlighter::setLazyHighlightingEnabled(bool enabled) {
+    if (_lazyHighlightingEnabled == enabled) return;
+
+    _lazyHighlightingEnabled = enabled;
+
+    // highlight the remaining blocks synchronously
+    if (!enabled && !_asyncHighlightingEnabled && !_deferredFrom.isNull()) {
+        processDeferredBlocks();
+    }
+}
+
+/**
+ * Tells the highlighter which blocks are visible in the editor, so deferred
+ * blocks in and near that range are highlighted first
+ *
+ * @param firstBlockNumber
+ * @param lastBlockNumber
+ */
+void MarkdownHighlighter::setVisibleBlockRange(int firstBlockNumber,
+                                               int lastBlockNumber) {
+    if (_visibleFirst == firstBlockNumber && _visibleLast == lastBlockNumber) {
+        return;
+    }
+
+    _visibleFirst = firstBlockNumber;
+    _visibleLast = lastBlockNumber;
+
+    if (_deferredFrom.isNull() || _visibleScheduled) return;
+
+    // the highlighting must not be changed while the editor is painted
+    _visibleScheduled = true;
+    QTimer::singleShot(0, this, &MarkdownHighlighter::highlightVisibleBlocks);
+}
+
+/**
+ * Tells the highlighter which text positions are visible, like from the
+ * positionAt() of a QML TextEdit for the corners of its viewport
+ *
+ * @param firstPosition
+ * @param lastPosition
+ */
+void MarkdownHighlighter::setVisiblePositionRange(int firstPosition,
+                                                  int lastPosition) {
+    if (!document()) return;
+
+    setVisibleBlockRange(document()->findBlock(firstPosition).blockNumber(),
+                         document()->findBlock(lastPosition).blockNumber());
+}
+
+/**
+ * Defers the highlighting of the blocks of the next burst (like when a
+ * document is loaded) also if neither the asynchronous nor the lazy
+ * highlighting is enabled, the deferred blocks are then highlighted lazily
+ */
+void MarkdownHighlighter::deferNextBurst() {
+    _deferNextBurst = true;
+    QTimer::singleShot(0, this, &MarkdownHighlighter::resetBurst);
+}
+
+/**
+ * Highlights a block in a BlockContext instead of the current block of the
+ * document, may be called from a worker thread
+ *
+ * @param text
+ * @param context
+ */
+void MarkdownHighlighter::highlightBlockInContext(const QString &text,
+                                                  BlockContext &context) {
+    context.state = NoState;
+    context.previousBlockState = NoPreviousBlockState;
+    context.formats.fill(QTextCharFormat(), text.length());
+    context.ranges.clear();
+
+    _context = &context;
+    highlightMarkdown(text);
+    _context = nullptr;
+}
+
+/**
+ * Decides if the current block is highlighted now, or is deferred to be
+ * highlighted later (lazily or in a worker thread) because a lot of blocks
+ * are highlighted in one go
+ *
+ * The formats of deferred blocks are kept until they get highlighted. Every
+ * highlighted block uses the current state of its predecessor and changed
+ * states are propagated by QSyntaxHighlighter, so once all deferred blocks
+ * are highlighted in order, the whole document is highlighted correctly.
+ *
+ * @param text
+ * @param blockState the state the block had before it got highlighted
+ * @return true if the block doesn't need to be highlighted now
+ */
+bool MarkdownHighlighter::highlightBlockDeferred(const QString &text,
+                                                 int blockState) {
+    // there are also results of the cache of highlighted documents
+    if (!_asyncResults.isEmpty() && applyAsyncResult(text)) return true;
+
+    if (_highlightingDeferredBlocks) {
+        if (!_deferredTimeSliced ||
+            _deferredTimer.elapsed() < lazyChunkBudget) {
+            advanceDeferredBlocks();
+            return false;
+        }
+    } else {
+        if (!_asyncHighlightingEnabled && !_lazyHighlightingEnabled &&
+            !_deferNextBurst) {
+            return false;
+        }
+
+        if (_burstCount++ == 0) {
+            QTimer::singleShot(0, this, &MarkdownHighlighter::resetBurst);
+        }
+
+        if (_burstCount <= syncBlockCount ||
+            isBlockVisible(currentBlock().blockNumber())) {
+            return false;
+        }
+    }
+
+    keepCurrentBlockHighlighting(blockState);
+    deferBlocks(currentBlock(), currentBlock());
+    if (_deferNextBurst) _deferredBurst = true;
+
+    return true;
+}
+
+/**
+ * Sets the formats and the state the current block had before, so a deferred
+ * block doesn't lose its highlighting
+ *
+ * @param blockState
+ */
+void MarkdownHighlighter::keepCurrentBlockHighlighting(int blockState) {
+    const QTextLayout *layout = currentBlock().layout();
+
+    if (layout) {
+#if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
+        const QList<QTextLayout::FormatRange> ranges =
+            layout->additionalFormats();
+#else
+        const QVector<QTextLayout::FormatRange> ranges = layout->formats();
+#endif
+
+        for (const QTextLayout::FormatRange &range : ranges) {
+            setFormat(range.start, range.length, range.format);
+        }
+    }
+
+    setCurrentBlockState(blockState);
+}
+
+/**
+ * Adds blocks to the range of deferred blocks
+ *
+ * @param first
+ * @param last
+ */
+void MarkdownHighlighter::deferBlocks(const QTextBlock &first,
+                                      const QTextBlock &last) {
+    if (!first.isValid() || !last.isValid()) return;
+
+    if (_deferredFrom.isNull()) {
+        _deferredFrom = QTextCursor(first);
+        _deferredTo = QTextCursor(last);
+        scheduleDeferredHighlighting();
+        scheduleProgressUpdate();
+        return;
+    }
+
+    if (first.position() < _deferredFrom.block().position()) {
+        _deferredFrom.setPosition(first.position());
+    }
+
+    if (last.position() > _deferredTo.block().position()) {
+        _deferredTo.setPosition(last.position());
+    }
+}
+
+void MarkdownHighlighter::clearDeferredBlocks() {
+    _deferredFrom = QTextCursor();
+    _deferredTo = QTextCursor();
+    _deferredBurst = false;
+}
+
+/**
+ * Removes the current block from the start of the deferred blocks, after it
+ * was highlighted in order
+ */
+void MarkdownHighlighter::advanceDeferredBlocks() {
+    if (_deferredFrom.isNull() || _deferredFrom.block() != currentBlock()) {
+        return;
+    }
+
+    if (currentBlock().position() >= _deferredTo.block().position() ||
+        !_deferredFrom.movePosition(QTextCursor::NextBlock)) {
+        clearDeferredBlocks();
+    }
+}
+
+/**
+ * Returns true if the block is in or near the visible range of the editor
+ *
+ * @param blockNumber
+ * @return
+ */
+bool MarkdownHighlighter::isBlockVisible(int blockNumber) const {
+    return _visibleLast >= 0 && blockNumber >= _visibleFirst - visibleMargin &&
+           blockNumber <= _visibleLast + visibleMargin;
+}
+
+/**
+ * Sets the memory budget of the cache of highlighted documents (see
+ * cacheDocumentState()), the cache is disabled with 0 (default)
+ *
+ * @param bytes
+ */
+void MarkdownHighlighter::setStateCacheBudget(qint64 bytes) {
+    _stateCache.setMaxCost(static_cast<int>(qBound(
+        qint64(0), bytes / 1024, qint64(std::numeric_limits<int>::max()))));
+}
+
+/**
+ * Returns the key of a text in the cache of highlighted documents
+ *
+ * Colliding keys only prevent the highlighting from being reused, because
+ * the text of every block is compared before.
+ *
+ * @param text
+ * @return
+ */
+quint64 MarkdownHighlighter::stateCacheKey(const QString &text) {
+    return (static_cast<quint64>(text.size()) << 32) |
+           static_cast<quint32>(qHash(text));
+}
+
+/**
+ * Stores the highlighting of the document in the cache of highlighted
+ * documents, the least recently used ones are removed if the cache gets too
+ * big, so switching back to the same text doesn't need to highlight it again
+ * (see restoreDocumentState())
+ *
+ * @return false if the cache is disabled or the document isn't highlighted
+ * completely yet
+ */
+bool MarkdownHighlighter::cacheDocumentState() {
+    if (_stateCache.maxCost() <= 0) return false;
+
+    auto *results = new QVector<BlockResult>();
+    if (!documentState(*results)) {
+        delete results;
+        return false;
+    }
+
+    const QString text = document()->toPlainText();
+
+    // the cache takes ownership of the results, also if they are too big
+    return _stateCache.insert(stateCacheKey(text), results,
+                              stateCacheCost(*results));
+}
+
+/**
+ * Highlights texts in parallel (see lexTexts()) and stores them in the cache
+ * of highlighted documents, so they don't need to be highlighted anymore
+ * when they are loaded with restoreDocumentState(), for example by
+ * QMarkdownTextEdit::loadPlainText()
+ *
+ * @param texts
+ */
+void MarkdownHighlighter::cacheDocumentStates(const QStringList &texts) {
+    if (_stateCache.maxCost() <= 0) return;
+
+    updateTheme();
+
+    QVector<QStringList> lines;
+    lines.reserve(texts.size());
+    for (const QString &text : texts) {
+        lines.append(text.split(QLatin1Char('\n')));
+    }
+
+    QVector<QVector<BlockResult>> results;
+    lexTexts(lines, _highlightingOptions, _theme, results);
+
+    for (int i = 0; i < texts.size(); ++i) {
+        auto *textResults = new QVector<BlockResult>();
+        textResults->swap(results[i]);
+        _stateCache.insert(stateCacheKey(texts.at(i)), textResults,
+                           stateCacheCost(*textResults));
+    }
+}
+
+/**
+ * Returns the cost of highlighting results in the cache of highlighted
+ * documents, in KiB
+ *
+ * @param results
+ * @return
+ */
+int MarkdownHighlighter::stateCacheCost(const QVector<BlockResult> &results) {
+    qint64 bytes = 0;
+    for (const BlockResult &result : results) {
+        bytes += blockResultSize(result);
+    }
+
+    return static_cast<int>(
+        qMin(bytes / 1024 + 1, qint64(std::numeric_limits<int>::max())));
+}
+
+/**
+ * Returns the approximate number of bytes of a block result
+ *
+ * @param result
+ * @return
+ */
+qint64 MarkdownHighlighter::blockResultSize(const BlockResult &result) {
+    return result.text.size() * sizeof(QChar) +
+           result.runs.size() * sizeof(FormatRun) +
+           result.ranges.size() * sizeof(InlineRange) + sizeof(BlockResult);
+}
+
+/**
+ * Reports the memory used by the highlighting of the document, like to
+ * compare the costs of documents
+ *
+ * @return
+ */
+MarkdownHighlighter::MemoryUsage MarkdownHighlighter::memoryUsage() const {
+    MemoryUsage usage;
+
+    if (QTextDocument *doc = document()) {
+        for (QTextBlock block = doc->begin(); block.isValid();
+             block = block.next()) {
+            if (const BlockData *data = blockData(block)) {
+                usage.blockData += data->memoryUsage();
+            }
+
+            const QTextLayout *layout = block.layout();
+            if (!layout) continue;
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
+            const int rangeCount = layout->additionalFormats().size();
+#else
+            const int rangeCount = layout->formats().size();
+#endif
+            usage.formatRanges +=
+                rangeCount * sizeof(QTextLayout::FormatRange);
+        }
+    }
+
+    for (const BlockResult &result : _asyncResults) {
+        usage.pendingResults += blockResultSize(result);
+    }
+
+    usage.stateCache = static_cast<qint64>(_stateCache.totalCost()) * 1024;
+
+    return usage;
+}
+
+/**
+ * Re-highlights the whole document like rehighlight(), but lexes its blocks
+ * in parallel before (see lexTexts()), for example after the theme or the
+ * default text formats were changed
+ */
+void MarkdownHighlighter::rehighlightInParallel() {
+    QTextDocument *doc = document();
+    if (!doc) return;
+
+    updateTheme();
+    clearDirtyBlocks();
+
+    QVector<QStringList> texts(1);
+    texts[0].reserve(doc->blockCount());
+    for (QTextBlock block = doc->begin(); block.isValid();
+         block = block.next()) {
+        texts[0].append(block.text());
+    }
+
+    QVector<QVector<BlockResult>> results;
+    lexTexts(texts, _highlightingOptions, _theme, results);
+
+    // the results are applied when the blocks are highlighted
+    for (const BlockResult &result : results.at(0)) {
+        _asyncResults.insert(result.blockNumber, result);
+    }
+
+    rehighlight();
+}
+
+/**
+ * Gets the highlighting of all blocks of the document
+ *
+ * @param results
+ * @return false if the document isn't highlighted completely yet
+ */
+bool MarkdownHighlighter::documentState(QVector<BlockResult> &results) const {
+    QTextDocument *doc = document();
+    if (!doc || doc->isEmpty()) return false;
+
+    if (!_deferredFrom.isNull() || _asyncJob || !_asyncResults.isEmpty() ||
+        !_dirtyTextBlocks.isEmpty()) {
+        return false;
+    }
+
+    results.reserve(doc->blockCount());
+
+    for (QTextBlock block = doc->begin(); block.isValid();
+         block = block.next()) {
+        BlockResult result;
+        result.blockNumber = block.blockNumber();
+        result.text = block.text();
+        result.previousState =
+            block.previous().isValid() ? block.previous().userState() : -1;
+        result.state = block.userState();
+
+        const QTextLayout *layout = block.layout();
+        if (layout) {
+#if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
+            const QList<QTextLayout::FormatRange> ranges =
+                layout->additionalFormats();
+#else
+            const QVector<QTextLayout::FormatRange> ranges = layout->formats();
+#endif
+
+            result.runs.reserve(ranges.size());
+            for (const QTextLayout::FormatRange &range : ranges) {
+                result.runs.append({range.start, range.length, range.format});
+            }
+        }
+
+        if (const BlockData *data = blockData(block)) {
+            result.ranges = data->inlineRanges();
+        }
+
+        results.append(result);
+    }
+
+    return true;
+}
+
+/**
+ * Returns a stable hash of the text of a block, that is also valid in other
+ * processes
+ *
+ * @param text
+ * @return
+ */
+static quint64 blockTextHash(const QChar *text, int length) {
+    // 64-bit FNV-1a
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    for (int i = 0; i < length; ++i) {
+        hash = (hash ^ text[i].unicode()) * Q_UINT64_C(1099511628211);
+    }
+
+    return hash;
+}
+
+/**
+ * Returns a fingerprint of the theme and the highlighting options, the
+ * serialized highlighting can only be used with the same fingerprint
+ *
+ * @return
+ */
+QByteArray MarkdownHighlighter::stateFingerprint() const {
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << static_cast<quint32>(_highlightingOptions);
+
+    for (const QTextCharFormat &format : _theme->formatTable) {
+        stream << format;
+    }
+
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+/**
+ * Serializes the highlighting of the document, so it can be stored by the
+ * application (like in a file next to the note) and restored with
+ * restoreDocumentState() the next time the text is opened
+ *
+ * The states, inline ranges and format runs of every block are stored
+ * together with the hashes of the block texts, the formats are only stored
+ * once.
+ *
+ * @return the serialized state or an empty QByteArray if the document isn't
+ * highlighted completely yet
+ */
+QByteArray MarkdownHighlighter::saveDocumentState() const {
+    QVector<BlockResult> results;
+    if (!documentState(results)) return QByteArray();
+
+    QVector<QTextCharFormat> formats;
+    QByteArray blocks;
+    QDataStream blockStream(&blocks, QIODevice::WriteOnly);
+    blockStream.setVersion(QDataStream::Qt_5_0);
+
+    for (const BlockResult &result : results) {
+        blockStream << static_cast<qint32>(result.text.size())
+                    << blockTextHash(result.text.constData(),
+                                     static_cast<int>(result.text.size()))
+                    << static_cast<qint32>(result.previousState)
+                    << static_cast<qint32>(result.state)
+                    << static_cast<quint32>(result.runs.size());
+
+        for (const FormatRun &run : result.runs) {
+            // consecutive runs often use the same format
+            int index = formats.isEmpty() ||
+                                !(formats.constLast() == run.format)
+                            ? formats.indexOf(run.format)
+                            : formats.size() - 1;
+            if (index == -1) {
+                index = formats.size();
+                formats.append(run.format);
+            }
+
+            blockStream << static_cast<qint32>(run.start)
+                        << static_cast<qint32>(run.length)
+                        << static_cast<quint32>(index);
+        }
+
+        blockStream << static_cast<quint32>(result.ranges.size());
+        for (const InlineRange &range : result.ranges) {
+            blockStream << static_cast<qint32>(range.begin)
+                        << static_cast<qint32>(range.end)
+                        << static_cast<quint8>(range.type);
+        }
+    }
+
+    QByteArray state;
+    QDataStream stream(&state, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << stateMagic << stateVersion << stateFingerprint()
+           << static_cast<quint32>(results.size())
+           << static_cast<quint32>(formats.size());
+
+    for (const QTextCharFormat &format : formats) {
+        stream << format;
+    }
+
+    stream.writeRawData(blocks.constData(), blocks.size());
+
+    return state;
+}
+
+/**
+ * Uses the highlighting serialized by saveDocumentState() when the text is
+ * set to the document next time, instead of highlighting it again
+ *
+ * Only the blocks whose text didn't change since the highlighting was
+ * serialized are taken from it, all other blocks are highlighted as usual.
+ *
+ * @param state
+ * @param text
+ * @return false if the state can't be used, because it's invalid or the
+ * theme or the highlighting options changed
+ */
+bool MarkdownHighlighter::restoreDocumentState(const QByteArray &state,
+                                               const QString &text) {
+    QDataStream stream(state);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QByteArray fingerprint;
+    quint32 blockCount = 0;
+    quint32 formatsSize = 0;
+    stream >> magic >> version >> fingerprint >> blockCount >> formatsSize;
+
+    if (stream.status() != QDataStream::Ok || magic != stateMagic ||
+        version != stateVersion || fingerprint != stateFingerprint()) {
+        return false;
+    }
+
+    QVector<QTextCharFormat> formats;
+    for (quint32 i = 0; i < formatsSize && stream.status() == QDataStream::Ok;
+         ++i) {
+        QTextFormat format;
+        stream >> format;
+        formats.append(format.toCharFormat());
+    }
+
+    QMap<int, BlockResult> results;
+    const QChar *textData = text.constData();
+    int lineStart = 0;
+
+    for (quint32 blockNumber = 0;
+         blockNumber < blockCount && stream.status() == QDataStream::Ok;
+         ++blockNumber) {
+        qint32 length = 0;
+        quint64 hash = 0;
+        qint32 previousState = NoState;
+        qint32 blockState = NoState;
+        quint32 runCount = 0;
+        stream >> length >> hash >> previousState >> blockState >> runCount;
+
+        BlockResult result;
+        result.blockNumber = static_cast<int>(blockNumber);
+        result.previousState = previousState;
+        result.state = blockState;
+
+        for (quint32 i = 0; i < runCount && stream.status() == QDataStream::Ok;
+             ++i) {
+            qint32 start = 0;
+            qint32 runLength = 0;
+            quint32 index = 0;
+            stream >> start >> runLength >> index;
+            if (index >= static_cast<quint32>(formats.size())) return false;
+
+            result.runs.append({start, runLength, formats.at(index)});
+        }
+
+        quint32 rangeCount = 0;
+        stream >> rangeCount;
+        for (quint32 i = 0;
+             i < rangeCount && stream.status() == QDataStream::Ok; ++i) {
+            qint32 begin = 0;
+            qint32 end = 0;
+            quint8 type = 0;
+            stream >> begin >> end >> type;
+            result.ranges.append(
+                InlineRange(begin, end, static_cast<RangeType>(type)));
+        }
+
+        // the block of the same number in the text
+        if (lineStart > text.size()) continue;
+
+        int lineEnd = text.indexOf(QLatin1Char('\n'), lineStart);
+        if (lineEnd == -1) lineEnd = text.size();
+        const int lineLength = lineEnd - lineStart;
+
+        if (lineLength == length &&
+            blockTextHash(textData + lineStart, lineLength) == hash) {
+            result.text = text.mid(lineStart, lineLength);
+            results.insert(result.blockNumber, result);
+        }
+
+        lineStart = lineEnd + 1;
+    }
+
+    if (stream.status() != QDataStream::Ok) return false;
+
+    for (auto it = results.cbegin(); it != results.cend(); ++it) {
+        _asyncResults.insert(it.key(), it.value());
+    }
+
+    return true;
+}
+
+/**
+ * Uses the cached highlighting of a text (see cacheDocumentState()) when the
+ * text is set to the document next time, instead of highlighting it again
+ *
+ * Blocks that don't match the cached highlighting are highlighted as usual.
+ *
+ * @param text
+ * @return false if there is no cached highlighting of the text
+ */
+bool MarkdownHighlighter::restoreDocumentState(const QString &text) {
+    const QVector<BlockResult> *results =
+        _stateCache.object(stateCacheKey(text));
+    if (!results) return false;
+
+    for (const BlockResult &result : *results) {
+        _asyncResults.insert(result.blockNumber, result);
+    }
+
+    return true;
+}
+
+void MarkdownHighlighter::resetBurst() {
+    _burstCount = 0;
+    _deferNextBurst = false;
+}
+
+void MarkdownHighlighter::scheduleDeferredHighlighting() {
+    if (_deferredScheduled) return;
+
+    _deferredScheduled = true;
+    QTimer::singleShot(0, this, &MarkdownHighlighter::processDeferredBlocks);
+}
+
+/**
+ * Hands the deferred blocks over to the worker thread, or highlights them
+ * lazily, or synchronously if neither mode is enabled (anymore)
+ */
+void MarkdownHighlighter::processDeferredBlocks() {
+    _deferredScheduled = false;
+    if (_deferredFrom.isNull()) return;
+
+    if (!document() || _deferredFrom.document() != document()) {
+        clearDeferredBlocks();
+        return;
     }
 
-    // highlight tables with starting |
-    {
-        HighlightingRule rule(HighlighterState::Table);
-        rule.shouldContain = QStringLiteral("|");
-        // Support up to 3 leading spaces, because md4c seems to support it
-        // See https://github.com/pbek/QOwnNotes/issues/3137
-        rule.pattern =
-            QRegularExpression(QStringLiteral("^\\s{0,3}(\\|.+?\\|)$"));
-        rule.capturingGroup = 1;
-        _highlightingRules.append(rule);
+    if (_asyncHighlightingEnabled) {
+        startAsyncHighlighting();
+    } else {
+        highlightDeferredBlocks(_lazyHighlightingEnabled || _deferredBurst);
     }
 }
 
 /**
- * Initializes the text formats
+ * Highlights the deferred blocks in order
  *
- * @param defaultFontSize
+ * @param timeSliced if true, only highlights blocks for lazyChunkBudget
+ * milliseconds and continues in the next event loop iteration
  */
-void MarkdownHighlighter::initTextFormats(int defaultFontSize) {
-    QTextCharFormat format;
+void MarkdownHighlighter::highlightDeferredBlocks(bool timeSliced) {
+    _highlightingDeferredBlocks = true;
+    _deferredTimeSliced = timeSliced;
+    _deferredTimer.start();
 
-    // set character formats for headlines
-    format = QTextCharFormat();
-    format.setForeground(QColor(2, 69, 150));
-    format.setFontWeight(QFont::Bold);
-    format.setFontPointSize(defaultFontSize * 1.6);
-    _formats[H1] = format;
-    format.setFontPointSize(defaultFontSize * 1.5);
-    _formats[H2] = format;
-    format.setFontPointSize(defaultFontSize * 1.4);
-    _formats[H3] = format;
-    format.setFontPointSize(defaultFontSize * 1.3);
-    _formats[H4] = format;
-    format.setFontPointSize(defaultFontSize * 1.2);
-    _formats[H5] = format;
-    format.setFontPointSize(defaultFontSize * 1.1);
-    _formats[H6] = format;
-    format.setFontPointSize(defaultFontSize);
+    while (!_deferredFrom.isNull()) {
+        if (timeSliced && _deferredTimer.elapsed() >= lazyChunkBudget) break;
 
-    // set character format for horizontal rulers
-    format = QTextCharFormat();
-    format.setForeground(Qt::darkGray);
-    format.setBackground(Qt::lightGray);
-    _formats[HorizontalRuler] = std::move(format);
+        // highlightBlock() advances _deferredFrom, QSyntaxHighlighter also
+        // highlights the next blocks as long as their state changes
+        const QTextBlock block = _deferredFrom.block();
+        rehighlightBlock(block);
 
-    // set character format for lists
-    format = QTextCharFormat();
-    format.setForeground(QColor(163, 0, 123));
-    _formats[List] = format;
+        if (!_deferredFrom.isNull() && _deferredFrom.block() == block) break;
+    }
 
-    // set character format for checkbox
-    format = QTextCharFormat();
-    format.setForeground(QColor(123, 100, 223));
-    _formats[CheckBoxUnChecked] = std::move(format);
-    // set character format for checked checkbox
-    format = QTextCharFormat();
-    format.setForeground(QColor(223, 50, 123));
-    _formats[CheckBoxChecked] = std::move(format);
+    _highlightingDeferredBlocks = false;
 
-    // set character format for links
-    format = QTextCharFormat();
-    format.setForeground(QColor(0, 128, 255));
-    format.setFontUnderline(true);
-    _formats[Link] = std::move(format);
+    if (_deferredFrom.isNull()) {
+        markHighlightingFinished();
+    } else {
+        scheduleDeferredHighlighting();
+    }
 
-    // set character format for images
-    format = QTextCharFormat();
-    format.setForeground(QColor(0, 191, 0));
-    format.setBackground(QColor(228, 255, 228));
-    _formats[Image] = std::move(format);
+    scheduleProgressUpdate();
+}
 
-    // set character format for code blocks
-    format = QTextCharFormat();
-    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
-    // format.setBackground(QColor(220, 220, 220));
-    _formats[CodeBlock] = format;
-    _formats[InlineCodeBlock] = format;
+/**
+ * Highlights the deferred blocks in and near the visible range of the editor
+ * with the current state of their predecessors, they are highlighted again
+ * when the deferred blocks before them are highlighted
+ */
+void MarkdownHighlighter::highlightVisibleBlocks() {
+    _visibleScheduled = false;
 
-    // set character format for italic
-    format = QTextCharFormat();
-    format.setFontWeight(QFont::StyleItalic);
-    format.setFontItalic(true);
-    _formats[Italic] = std::move(format);
+    if (_deferredFrom.isNull() || _deferredFrom.document() != document()) {
+        return;
+    }
 
-    // set character format for underline
-    format = QTextCharFormat();
-    format.setFontUnderline(true);
-    _formats[StUnderline] = std::move(format);
+    const int from =
+        qMax(_visibleFirst - visibleMargin, _deferredFrom.blockNumber());
+    const int to =
+        qMin(_visibleLast + visibleMargin, _deferredTo.blockNumber());
 
-    // set character format for bold
-    format = QTextCharFormat();
-    format.setFontWeight(QFont::Bold);
-    _formats[Bold] = std::move(format);
+    for (QTextBlock block = document()->findBlockByNumber(from);
+         block.isValid() && block.blockNumber() <= to; block = block.next()) {
+        rehighlightBlock(block);
+    }
+}
 
-    // set character format for comments
-    format = QTextCharFormat();
-    format.setForeground(QBrush(Qt::gray));
-    _formats[Comment] = std::move(format);
+/******************************
+ *  ASYNCHRONOUS HIGHLIGHTING
+ ******************************/
 
-    // set character format for masked syntax
-    format = QTextCharFormat();
-    format.setForeground(QColor(204, 204, 204));
-    _formats[MaskedSyntax] = std::move(format);
+/**
+ * Applies the asynchronous result for the current block
+ *
+ * @param text
+ * @return true if there was a valid result for the block
+ */
+bool MarkdownHighlighter::applyAsyncResult(const QString &text) {
+    const int blockNumber = currentBlock().blockNumber();
+    const auto it = _asyncResults.find(blockNumber);
+    if (it == _asyncResults.end()) return false;
 
-    // set character format for tables
-    format = QTextCharFormat();
-    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
-    format.setForeground(QColor(100, 148, 73));
-    _formats[Table] = std::move(format);
+    const BlockResult result = it.value();
+    _asyncResults.erase(it);
 
-    // set character format for block quotes
-    format = QTextCharFormat();
-    format.setForeground(Qt::darkRed);
-    _formats[BlockQuote] = std::move(format);
+    // the result can't be used if the block or its predecessor changed
+    // since the snapshot was taken
+    if (result.text != text || result.previousState != previousBlockState()) {
+        return false;
+    }
 
-    format = QTextCharFormat();
-    _formats[HeadlineEnd] = std::move(format);
-    _formats[NoState] = std::move(format);
+    for (const FormatRun &run : result.runs) {
+        setFormat(run.start, run.length, run.format);
+    }
 
-    // set character format for trailing spaces
-    format.setBackground(QColor(252, 175, 62));
-    _formats[TrailingSpace] = std::move(format);
+    setCurrentBlockState(result.state);
+    setCurrentBlockData(text, result.ranges);
 
-    /****************************************
-     * Formats for syntax highlighting
-     ***************************************/
+    if (result.previousBlockState != NoPreviousBlockState) {
+        markPreviousBlockDirty(result.previousBlockState);
+    }
 
-    format = QTextCharFormat();
-    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
-    format.setForeground(QColor(249, 38, 114));
-    _formats[CodeKeyWord] = std::move(format);
+    return true;
+}
 
-    format = QTextCharFormat();
-    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
-    format.setForeground(QColor(163, 155, 78));
-    _formats[CodeString] = std::move(format);
+/**
+ * Starts highlighting the deferred blocks and all blocks after them in a
+ * worker thread
+ */
+void MarkdownHighlighter::startAsyncHighlighting() {
+    int from = _deferredFrom.blockNumber();
+    clearDeferredBlocks();
+
+    // the blocks a running job didn't deliver yet need to be covered too
+    const int undelivered = stopAsyncHighlighting();
+    if (undelivered != -1) from = qMin(from, undelivered);
+
+    const QTextBlock firstBlock = document()->findBlockByNumber(from);
+    if (!firstBlock.isValid()) return;
+
+    _asyncJob = new AsyncJob(this, _highlightingOptions);
+    _asyncJob->firstBlockNumber = from;
+    _asyncJob->nextBlockNumber = from;
+    _asyncJob->previousText = firstBlock.previous().text();
+    _asyncJob->previousState = firstBlock.previous().userState();
+
+    for (QTextBlock block = firstBlock; block.isValid();
+         block = block.next()) {
+        _asyncJob->texts.append(block.text());
+    }
 
-    format = QTextCharFormat();
-    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
-    format.setForeground(QColor(117, 113, 94));
-    _formats[CodeComment] = std::move(format);
+    QThreadPool::globalInstance()->start(_asyncJob);
+    scheduleProgressUpdate();
+}
 
-    format = QTextCharFormat();
-    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
-    format.setForeground(QColor(84, 174, 191));
-    _formats[CodeType] = std::move(format);
+/**
+ * Stops the asynchronous highlighting job, the results it already delivered
+ * are kept
+ *
+ * @return the number of the first block the job didn't deliver a result for,
+ * -1 if there was no unfinished job
+ */
+int MarkdownHighlighter::stopAsyncHighlighting() {
+    if (!_asyncJob) return -1;
 
-    format = QTextCharFormat();
-    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
-    format.setForeground(QColor(219, 135, 68));
-    _formats[CodeOther] = std::move(format);
+    _asyncJob->cancelled.storeRelease(1);
 
-    format = QTextCharFormat();
-    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
-    format.setForeground(QColor(174, 129, 255));
-    _formats[CodeNumLiteral] = std::move(format);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    // the job didn't start yet
+    if (QThreadPool::globalInstance()->tryTake(_asyncJob)) {
+        QMutexLocker locker(&_asyncJob->mutex);
+        _asyncJob->running = false;
+    }
+#endif
 
-    format = QTextCharFormat();
-    format.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
-    format.setForeground(QColor(1, 138, 15));
-    _formats[CodeBuiltIn] = std::move(format);
+    {
+        QMutexLocker locker(&_asyncJob->mutex);
+        while (_asyncJob->running) {
+            _asyncJob->stopped.wait(&_asyncJob->mutex);
+        }
+    }
+
+    takeAsyncResults();
+
+    const int nextBlockNumber =
+        _asyncJob->finished ? -1 : _asyncJob->nextBlockNumber;
+    delete _asyncJob;
+    _asyncJob = nullptr;
+
+    return nextBlockNumber;
 }
 
 /**
- * @brief initializes the langStringToEnum
+ * Moves the results the worker thread published to the pending results
  */
-void MarkdownHighlighter::initCodeLangs() {
-    MarkdownHighlighter::_langStringToEnum =
-        QHash<QString, MarkdownHighlighter::HighlighterState>{
-            {QLatin1String("bash"), MarkdownHighlighter::CodeBash},
-            {QLatin1String("c"), MarkdownHighlighter::CodeC},
-            {QLatin1String("cpp"), MarkdownHighlighter::CodeCpp},
-            {QLatin1String("cxx"), MarkdownHighlighter::CodeCpp},
-            {QLatin1String("c++"), MarkdownHighlighter::CodeCpp},
-            {QLatin1String("c#"), MarkdownHighlighter::CodeCSharp},
-            {QLatin1String("cmake"), MarkdownHighlighter::CodeCMake},
-            {QLatin1String("csharp"), MarkdownHighlighter::CodeCSharp},
-            {QLatin1String("css"), MarkdownHighlighter::CodeCSS},
-            {QLatin1String("go"), MarkdownHighlighter::CodeGo},
-            {QLatin1String("html"), MarkdownHighlighter::CodeXML},
-            {QLatin1String("ini"), MarkdownHighlighter::CodeINI},
-            {QLatin1String("java"), MarkdownHighlighter::CodeJava},
-            {QLatin1String("javascript"), MarkdownHighlighter::CodeJava},
-            {QLatin1String("js"), MarkdownHighlighter::CodeJs},
-            {QLatin1String("json"), MarkdownHighlighter::CodeJSON},
-            {QLatin1String("make"), MarkdownHighlighter::CodeMake},
-            {QLatin1String("nix"), MarkdownHighlighter::CodeNix},
-            {QLatin1String("php"), MarkdownHighlighter::CodePHP},
-            {QLatin1String("py"), MarkdownHighlighter::CodePython},
-            {QLatin1String("python"), MarkdownHighlighter::CodePython},
-            {QLatin1String("qml"), MarkdownHighlighter::CodeQML},
-            {QLatin1String("rust"), MarkdownHighlighter::CodeRust},
-            {QLatin1String("sh"), MarkdownHighlighter::CodeBash},
-            {QLatin1String("sql"), MarkdownHighlighter::CodeSQL},
-            {QLatin1String("taggerscript"),
-             MarkdownHighlighter::CodeTaggerScript},
-            {QLatin1String("ts"), MarkdownHighlighter::CodeTypeScript},
-            {QLatin1String("typescript"), MarkdownHighlighter::CodeTypeScript},
-            {QLatin1String("v"), MarkdownHighlighter::CodeV},
-            {QLatin1String("vex"), MarkdownHighlighter::CodeVex},
-            {QLatin1String("xml"), MarkdownHighlighter::CodeXML},
-            {QLatin1String("yml"), MarkdownHighlighter::CodeYAML},
-            {QLatin1String("yaml"), MarkdownHighlighter::CodeYAML},
-            {QLatin1String("forth"), MarkdownHighlighter::CodeForth},
-            {QLatin1String("systemverilog"),
-             MarkdownHighlighter::CodeSystemVerilog},
-            {QLatin1String("gdscript"), MarkdownHighlighter::CodeGDScript},
-            {QLatin1String("toml"), MarkdownHighlighter::CodeTOML},
-        };
+void MarkdownHighlighter::takeAsyncResults() {
+    if (!_asyncJob) return;
+
+    QVector<BlockResult> results;
+    {
+        QMutexLocker locker(&_asyncJob->mutex);
+        _asyncJob->eventPending = false;
+        results.swap(_asyncJob->results);
+    }
+
+    for (const BlockResult &result : results) {
+        _asyncResults.insert(result.blockNumber, result);
+    }
 }
 
 /**
- * Sets the text formats
- *
- * @param formats
+ * Applies the pending results to the document, the time spent is limited
+ * per event loop iteration to keep the editor responsive
  */
-void MarkdownHighlighter::setTextFormats(
-    QHash<HighlighterState, QTextCharFormat> formats) {
-    _formats = std::move(formats);
+void MarkdownHighlighter::applyAsyncResults() {
+    _asyncApplyScheduled = false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (!_asyncResults.isEmpty()) {
+        if (timer.elapsed() >= asyncApplyBudget) {
+            _asyncApplyScheduled = true;
+            QTimer::singleShot(0, this,
+                               &MarkdownHighlighter::applyAsyncResults);
+            scheduleProgressUpdate();
+            return;
+        }
+
+        // the result is consumed by highlightBlock() and still removed
+        // here, in case it was outdated
+        const int blockNumber = _asyncResults.firstKey();
+        const QTextBlock block =
+            document() ? document()->findBlockByNumber(blockNumber)
+                       : QTextBlock();
+        if (block.isValid()) rehighlightBlock(block);
+        _asyncResults.remove(blockNumber);
+    }
+
+    if (_asyncJob) {
+        bool finished;
+        {
+            QMutexLocker locker(&_asyncJob->mutex);
+            finished = _asyncJob->finished && _asyncJob->results.isEmpty();
+        }
+
+        if (!finished) {
+            scheduleProgressUpdate();
+            return;
+        }
+
+        stopAsyncHighlighting();
+    }
+
+    markHighlightingFinished();
+    scheduleProgressUpdate();
 }
 
 /**
- * Sets a text format
+ * Returns the number of the first block that still needs to be highlighted
+ * by the deferred or asynchronous highlighting
  *
- * @param formats
+ * @return -1 if there is no such block
  */
-void MarkdownHighlighter::setTextFormat(HighlighterState state,
-                                        QTextCharFormat format) {
-    _formats[state] = std::move(format);
+int MarkdownHighlighter::pendingBlockNumber() const {
+    int pending = std::numeric_limits<int>::max();
+
+    if (!_deferredFrom.isNull()) pending = _deferredFrom.blockNumber();
+    if (!_asyncResults.isEmpty()) {
+        pending = qMin(pending, _asyncResults.firstKey());
+    }
+
+    if (_asyncJob) {
+        QMutexLocker locker(&_asyncJob->mutex);
+        if (!_asyncJob->results.isEmpty()) {
+            pending = qMin(pending, _asyncJob->results.first().blockNumber);
+        } else if (!_asyncJob->finished) {
+            pending = qMin(pending, _asyncJob->nextBlockNumber);
+        }
+    }
+
+    return pending == std::numeric_limits<int>::max() ? -1 : pending;
+}
+
+void MarkdownHighlighter::scheduleProgressUpdate() {
+    if (_progressScheduled) return;
+
+    // the signals are not emitted while blocks are highlighted
+    _progressScheduled = true;
+    QTimer::singleShot(0, this, &MarkdownHighlighter::updateProgress);
 }
 
 /**
- * Does the Markdown highlighting
- *
- * @param text
+ * Updates the busy and progress properties, that tell QML user interfaces
+ * how much of the document is highlighted
  */
-void MarkdownHighlighter::highlightBlock(const QString &text) {
-    if (currentBlockState() == HeadlineEnd) {
-        currentBlock().previous().setUserState(NoState);
-        addDirtyBlock(currentBlock().previous());
+void MarkdownHighlighter::updateProgress() {
+    _progressScheduled = false;
+
+    const int pending = pendingBlockNumber();
+    const int blockCount = document() ? document()->blockCount() : 0;
+    const bool busy = pending != -1;
+    const qreal progress =
+        busy && blockCount > 0 ? qreal(pending) / blockCount : 1.0;
+
+    if (!qFuzzyCompare(1.0 + progress, 1.0 + _progress)) {
+        _progress = progress;
+        Q_EMIT progressChanged();
     }
-    setCurrentBlockState(HighlighterState::NoState);
-    currentBlock().setUserState(HighlighterState::NoState);
 
-    highlightMarkdown(text);
-    _highlightingFinished = true;
+    if (busy != _busy) {
+        _busy = busy;
+        Q_EMIT busyChanged();
+    }
+}
+
+void MarkdownHighlighter::customEvent(QEvent *event) {
+    if (event->type() != asyncResultsEventType()) {
+        QSyntaxHighlighter::customEvent(event);
+        return;
+    }
+
+    takeAsyncResults();
+    if (!_asyncApplyScheduled) applyAsyncResults();
 }
 
 void MarkdownHighlighter::highlightMarkdown(const QString &text) {
@@ -423,7 +2466,7 @@ void MarkdownHighlighter::highlightMarkdown(const QString &text) {
                                   text.startsWith(QLatin1String("~~~"));
 
     if (!text.isEmpty() && !isBlockCodeBlock) {
-        highlightAdditionalRules(_highlightingRules, text);
+        highlightAdditionalRules(_theme->highlightingRules, text);
 
         highlightThematicBreak(text);
 
@@ -529,6 +2572,8 @@ static bool isParagraph(const QString &text) {
  * @param text
  */
 void MarkdownHighlighter::highlightHeadline(const QString &text) {
+    MH_MEASURE_PHASE(HeadlinePhase, text);
+
     // three spaces indentation is allowed in headings
     const int spacesOffset = getIndentation(text);
 
@@ -553,13 +2598,13 @@ void MarkdownHighlighter::highlightHeadline(const QString &text) {
 
             // Set styling of the "#"s to "masked syntax", but with the size of
             // the heading
-            auto maskedFormat = _formats[MaskedSyntax];
-            maskedFormat.setFontPointSize(_formats[state].fontPointSize());
+            auto maskedFormat = textFormat(MaskedSyntax);
+            maskedFormat.setFontPointSize(textFormat(state).fontPointSize());
             setFormat(0, headingLevel, maskedFormat);
 
             // Set the styling of the rest of the heading
             setFormat(headingLevel + 1, text.length() - 1 - headingLevel,
-                      _formats[state]);
+                      textFormat(state));
 
             setCurrentBlockState(state);
             return;
@@ -576,7 +2621,7 @@ void MarkdownHighlighter::highlightHeadline(const QString &text) {
     };
 
     // take care of ==== and ---- headlines
-    const QString prev = currentBlock().previous().text();
+    const QString prev = previousBlockText();
     auto prevSpaces = getIndentation(prev);
     const bool isPrevParagraph = isParagraph(prev);
 
@@ -600,7 +2645,7 @@ void MarkdownHighlighter::highlightHeadline(const QString &text) {
         }
     }
 
-    const QString nextBlockText = currentBlock().next().text();
+    const QString nextBlockText = this->nextBlockText();
     if (nextBlockText.isEmpty()) return;
     const int nextSpaces = getIndentation(nextBlockText);
     const bool isCurrentParagraph = isParagraph(text);
@@ -612,7 +2657,7 @@ void MarkdownHighlighter::highlightHeadline(const QString &text) {
         const bool nextHasEqualChars =
             hasOnlyHeadChars(nextBlockText, QLatin1Char('='), nextSpaces);
         if (nextHasEqualChars) {
-            setFormat(0, text.length(), _formats[HighlighterState::H1]);
+            setFormat(0, text.length(), textFormat(HighlighterState::H1));
             setCurrentBlockState(HighlighterState::H1);
         }
     } else if (nextBlockText.at(nextSpaces) == QLatin1Char('-') &&
@@ -620,7 +2665,7 @@ void MarkdownHighlighter::highlightHeadline(const QString &text) {
         const bool nextHasMinusChars =
             hasOnlyHeadChars(nextBlockText, QLatin1Char('-'), nextSpaces);
         if (nextHasMinusChars) {
-            setFormat(0, text.length(), _formats[HighlighterState::H2]);
+            setFormat(0, text.length(), textFormat(HighlighterState::H2));
             setCurrentBlockState(HighlighterState::H2);
         }
     }
@@ -629,8 +2674,7 @@ void MarkdownHighlighter::highlightHeadline(const QString &text) {
 void MarkdownHighlighter::highlightSubHeadline(const QString &text,
                                                HighlighterState state) {
     const QTextCharFormat &maskedFormat =
-        _formats[HighlighterState::MaskedSyntax];
-    QTextBlock previousBlock = currentBlock().previous();
+        textFormat(HighlighterState::MaskedSyntax);
 
     // we check for both H1/H2 so that if the user changes his mind, and changes
     // === to ---, changes be reflected immediately
@@ -638,7 +2682,7 @@ void MarkdownHighlighter::highlightSubHeadline(const QString &text,
         previousBlockState() == NoState) {
         QTextCharFormat currentMaskedFormat = maskedFormat;
         // set the font size from the current rule's font format
-        currentMaskedFormat.setFontPointSize(_formats[state].fontPointSize());
+        currentMaskedFormat.setFontPointSize(textFormat(state).fontPointSize());
 
         setFormat(0, text.length(), currentMaskedFormat);
         setCurrentBlockState(HeadlineEnd);
@@ -650,8 +2694,7 @@ void MarkdownHighlighter::highlightSubHeadline(const QString &text,
         // causes text to be formatted the same way when writing after
         // the text
         if (previousBlockState() != state) {
-            addDirtyBlock(previousBlock);
-            previousBlock.setUserState(state);
+            markPreviousBlockDirty(state);
         }
     }
 }
@@ -666,7 +2709,7 @@ void MarkdownHighlighter::highlightIndentedCodeBlock(const QString &text) {
                            !text.startsWith(QLatin1Char('\t'))))
         return;
 
-    const QString prevTrimmed = currentBlock().previous().text().trimmed();
+    const QString prevTrimmed = previousBlockText().trimmed();
     // previous line must be empty according to CommonMark except if it is a
     // heading https://spec.commonmark.org/0.29/#indented-code-block
     if (!prevTrimmed.isEmpty() && previousBlockState() != CodeBlockIndented &&
@@ -683,7 +2726,7 @@ void MarkdownHighlighter::highlightIndentedCodeBlock(const QString &text) {
         return;
 
     setCurrentBlockState(CodeBlockIndented);
-    setFormat(0, text.length(), _formats[CodeBlock]);
+    setFormat(0, text.length(), textFormat(CodeBlock));
 }
 
 void MarkdownHighlighter::highlightCodeFence(const QString &text) {
@@ -715,10 +2758,10 @@ void MarkdownHighlighter::highlightCodeBlock(const QString &text,
         // interpret it as inline code, not code block
         if (text.endsWith(QLatin1String("```")) && text.length() > 3) {
             setFormat(3, text.length() - 3,
-                      _formats[HighlighterState::InlineCodeBlock]);
-            setFormat(0, 3, _formats[HighlighterState::MaskedSyntax]);
+                      textFormat(HighlighterState::InlineCodeBlock));
+            setFormat(0, 3, textFormat(HighlighterState::MaskedSyntax));
             setFormat(text.length() - 3, 3,
-                      _formats[HighlighterState::MaskedSyntax]);
+                      textFormat(HighlighterState::MaskedSyntax));
             return;
         }
         if ((previousBlockState() != CodeBlock &&
@@ -727,7 +2770,8 @@ void MarkdownHighlighter::highlightCodeBlock(const QString &text,
              previousBlockState() != CodeBlockTildeComment) &&
             previousBlockState() < CodeCpp) {
             const QString &lang = text.mid(3, text.length()).toLower();
-            HighlighterState progLang = _langStringToEnum.value(lang);
+            HighlighterState progLang = _theme->langStringToEnum.value(lang);
+            if (progLang < CodeCpp) progLang = registeredLanguageState(lang);
 
             if (progLang >= CodeCpp) {
                 const int state = text.startsWith(QLatin1String("```"))
@@ -747,8 +2791,8 @@ void MarkdownHighlighter::highlightCodeBlock(const QString &text,
         }
 
         // set the font size from the current rule's font format
-        QTextCharFormat &maskedFormat = _formats[MaskedSyntax];
-        maskedFormat.setFontPointSize(_formats[CodeBlock].fontPointSize());
+        QTextCharFormat maskedFormat = textFormat(MaskedSyntax);
+        maskedFormat.setFontPointSize(textFormat(CodeBlock).fontPointSize());
 
         setFormat(0, text.length(), maskedFormat);
     } else if (isCodeBlock(previousBlockState())) {
@@ -764,6 +2808,9 @@ void MarkdownHighlighter::highlightCodeBlock(const QString &text,
 void MarkdownHighlighter::highlightSyntax(const QString &text) {
     if (text.isEmpty()) return;
 
+    MH_MEASURE_PHASE(SyntaxPhase, text);
+    MH_MEASURE_LANGUAGE(languageState(currentBlockState()), text);
+
     const auto textLen = text.length();
 
     QChar comment;
@@ -775,98 +2822,94 @@ void MarkdownHighlighter::highlightSyntax(const QString &text) {
     bool isSQL = false;
     bool isTOML = false;
 
-    QMultiHash<char, QLatin1String> keywords{};
-    QMultiHash<char, QLatin1String> others{};
-    QMultiHash<char, QLatin1String> types{};
-    QMultiHash<char, QLatin1String> builtin{};
-    QMultiHash<char, QLatin1String> literals{};
+    const LanguageData *langData = nullptr;
 
     // apply the default code block format first
-    setFormat(0, textLen, _formats[CodeBlock]);
+    setFormat(0, textLen, textFormat(CodeBlock));
 
     switch (currentBlockState()) {
         case HighlighterState::CodeCpp:
         case HighlighterState::CodeCpp + tildeOffset:
         case HighlighterState::CodeCppComment:
         case HighlighterState::CodeCppComment + tildeOffset:
-            loadCppData(types, keywords, builtin, literals, others);
+            langData = &loadCppData();
             break;
         case HighlighterState::CodeJs:
         case HighlighterState::CodeJs + tildeOffset:
         case HighlighterState::CodeJsComment:
         case HighlighterState::CodeJsComment + tildeOffset:
-            loadJSData(types, keywords, builtin, literals, others);
+            langData = &loadJSData();
             break;
         case HighlighterState::CodeC:
         case HighlighterState::CodeC + tildeOffset:
         case HighlighterState::CodeCComment:
         case HighlighterState::CodeCComment + tildeOffset:
-            loadCppData(types, keywords, builtin, literals, others);
+            langData = &loadCppData();
             break;
         case HighlighterState::CodeBash:
         case HighlighterState::CodeBash + tildeOffset:
-            loadShellData(types, keywords, builtin, literals, others);
+            langData = &loadShellData();
             comment = QLatin1Char('#');
             break;
         case HighlighterState::CodePHP:
         case HighlighterState::CodePHP + tildeOffset:
         case HighlighterState::CodePHPComment:
         case HighlighterState::CodePHPComment + tildeOffset:
-            loadPHPData(types, keywords, builtin, literals, others);
+            langData = &loadPHPData();
             break;
         case HighlighterState::CodeQML:
         case HighlighterState::CodeQML + tildeOffset:
         case HighlighterState::CodeQMLComment:
         case HighlighterState::CodeQMLComment + tildeOffset:
-            loadQMLData(types, keywords, builtin, literals, others);
+            langData = &loadQMLData();
             break;
         case HighlighterState::CodePython:
         case HighlighterState::CodePython + tildeOffset:
-            loadPythonData(types, keywords, builtin, literals, others);
+            langData = &loadPythonData();
             comment = QLatin1Char('#');
             break;
         case HighlighterState::CodeRust:
         case HighlighterState::CodeRust + tildeOffset:
         case HighlighterState::CodeRustComment:
         case HighlighterState::CodeRustComment + tildeOffset:
-            loadRustData(types, keywords, builtin, literals, others);
+            langData = &loadRustData();
             break;
         case HighlighterState::CodeJava:
         case HighlighterState::CodeJava + tildeOffset:
         case HighlighterState::CodeJavaComment:
         case HighlighterState::CodeJavaComment + tildeOffset:
-            loadJavaData(types, keywords, builtin, literals, others);
+            langData = &loadJavaData();
             break;
         case HighlighterState::CodeCSharp:
         case HighlighterState::CodeCSharp + tildeOffset:
         case HighlighterState::CodeCSharpComment:
         case HighlighterState::CodeCSharpComment + tildeOffset:
-            loadCSharpData(types, keywords, builtin, literals, others);
+            langData = &loadCSharpData();
             break;
         case HighlighterState::CodeGo:
         case HighlighterState::CodeGo + tildeOffset:
         case HighlighterState::CodeGoComment:
         case HighlighterState::CodeGoComment + tildeOffset:
-            loadGoData(types, keywords, builtin, literals, others);
+            langData = &loadGoData();
             break;
         case HighlighterState::CodeV:
         case HighlighterState::CodeV + tildeOffset:
         case HighlighterState::CodeVComment:
         case HighlighterState::CodeVComment + tildeOffset:
-            loadVData(types, keywords, builtin, literals, others);
+            langData = &loadVData();
             break;
         case HighlighterState::CodeSQL:
         case HighlighterState::CodeSQL + tildeOffset:
         case HighlighterState::CodeSQLComment:
         case HighlighterState::CodeSQLComment + tildeOffset:
-            loadSQLData(types, keywords, builtin, literals, others);
+            langData = &loadSQLData();
             isSQL = true;
             comment =
                 QLatin1Char('-');    // prevent the default comment highlighting
             break;
         case HighlighterState::CodeJSON:
         case HighlighterState::CodeJSON + tildeOffset:
-            loadJSONData(types, keywords, builtin, literals, others);
+            langData = &loadJSONData();
             break;
         case HighlighterState::CodeXML:
         case HighlighterState::CodeXML + tildeOffset:
@@ -877,19 +2920,19 @@ void MarkdownHighlighter::highlightSyntax(const QString &text) {
         case HighlighterState::CodeCSSComment:
         case HighlighterState::CodeCSSComment + tildeOffset:
             isCSS = true;
-            loadCSSData(types, keywords, builtin, literals, others);
+            langData = &loadCSSData();
             break;
         case HighlighterState::CodeTypeScript:
         case HighlighterState::CodeTypeScript + tildeOffset:
         case HighlighterState::CodeTypeScriptComment:
         case HighlighterState::CodeTypeScriptComment + tildeOffset:
-            loadTypescriptData(types, keywords, builtin, literals, others);
+            langData = &loadTypescriptData();
             break;
         case HighlighterState::CodeYAML:
         case HighlighterState::CodeYAML + tildeOffset:
             isYAML = true;
             comment = QLatin1Char('#');
-            loadYAMLData(types, keywords, builtin, literals, others);
+            langData = &loadYAMLData();
             break;
         case HighlighterState::CodeINI:
         case HighlighterState::CodeINI + tildeOffset:
@@ -903,22 +2946,22 @@ void MarkdownHighlighter::highlightSyntax(const QString &text) {
         case HighlighterState::CodeVex + tildeOffset:
         case HighlighterState::CodeVexComment:
         case HighlighterState::CodeVexComment + tildeOffset:
-            loadVEXData(types, keywords, builtin, literals, others);
+            langData = &loadVEXData();
             break;
         case HighlighterState::CodeCMake:
         case HighlighterState::CodeCMake + tildeOffset:
-            loadCMakeData(types, keywords, builtin, literals, others);
+            langData = &loadCMakeData();
             comment = QLatin1Char('#');
             break;
         case HighlighterState::CodeMake:
         case HighlighterState::CodeMake + tildeOffset:
             isMake = true;
-            loadMakeData(types, keywords, builtin, literals, others);
+            langData = &loadMakeData();
             comment = QLatin1Char('#');
             break;
         case HighlighterState::CodeNix:
         case HighlighterState::CodeNix + tildeOffset:
-            loadNixData(types, keywords, builtin, literals, others);
+            langData = &loadNixData();
             comment = QLatin1Char('#');
             break;
         case HighlighterState::CodeForth:
@@ -926,16 +2969,16 @@ void MarkdownHighlighter::highlightSyntax(const QString &text) {
         case HighlighterState::CodeForthComment:
         case HighlighterState::CodeForthComment + tildeOffset:
             isForth = true;
-            loadForthData(types, keywords, builtin, literals, others);
+            langData = &loadForthData();
             break;
         case HighlighterState::CodeSystemVerilog:
         case HighlighterState::CodeSystemVerilogComment:
-            loadSystemVerilogData(types, keywords, builtin, literals, others);
+            langData = &loadSystemVerilogData();
             break;
         case HighlighterState::CodeGDScript:
         case HighlighterState::CodeGDScript + tildeOffset:
             isGDScript = true;
-            loadGDScriptData(types, keywords, builtin, literals, others);
+            langData = &loadGDScriptData();
             comment = QLatin1Char('#');
             break;
         case HighlighterState::CodeTOML:
@@ -943,45 +2986,28 @@ void MarkdownHighlighter::highlightSyntax(const QString &text) {
         case HighlighterState::CodeTOMLString:
         case HighlighterState::CodeTOMLString + tildeOffset:
             isTOML = true;
-            loadTOMLData(types, keywords, builtin, literals, others);
+            langData = &loadTOMLData();
             comment = QLatin1Char('#');
             break;
-        default:
-            setFormat(0, textLen, _formats[CodeBlock]);
-            return;
-    }
-
-    auto applyCodeFormat =
-        [this](int i, const QMultiHash<char, QLatin1String> &data,
-               const QString &text, const QTextCharFormat &fmt) -> int {
-        // check if we are at the beginning OR if this is the start of a word
-        if (i == 0 || (!text.at(i - 1).isLetterOrNumber() &&
-                       text.at(i - 1) != QLatin1Char('_'))) {
-            const char c = text.at(i).toLatin1();
-            auto it = data.find(c);
-            for (; it != data.end() && it.key() == c; ++it) {
-                // we have a word match check
-                // 1. if we are at the end
-                // 2. if we have a complete word
-                const QLatin1String &word = it.value();
-                if (word == MH_SUBSTR(i, word.size()) &&
-                    (i + word.size() == text.length() ||
-                     (!text.at(i + word.size()).isLetterOrNumber() &&
-                      text.at(i + word.size()) != QLatin1Char('_')))) {
-                    setFormat(i, word.size(), fmt);
-                    i += word.size();
-                }
+        default: {
+            const RegisteredLanguage *language =
+                registeredLanguage(currentBlockState());
+            if (!language) {
+                setFormat(0, textLen, textFormat(CodeBlock));
+                return;
             }
+            langData = &language->loader();
+            comment = language->lineComment;
+            break;
         }
-        return i;
-    };
+    }
 
-    const QTextCharFormat &formatType = _formats[CodeType];
-    const QTextCharFormat &formatKeyword = _formats[CodeKeyWord];
-    const QTextCharFormat &formatComment = _formats[CodeComment];
-    const QTextCharFormat &formatNumLit = _formats[CodeNumLiteral];
-    const QTextCharFormat &formatBuiltIn = _formats[CodeBuiltIn];
-    const QTextCharFormat &formatOther = _formats[CodeOther];
+    const QTextCharFormat &formatType = textFormat(CodeType);
+    const QTextCharFormat &formatKeyword = textFormat(CodeKeyWord);
+    const QTextCharFormat &formatComment = textFormat(CodeComment);
+    const QTextCharFormat &formatNumLit = textFormat(CodeNumLiteral);
+    const QTextCharFormat &formatBuiltIn = textFormat(CodeBuiltIn);
+    const QTextCharFormat &formatOther = textFormat(CodeOther);
 
     for (int i = 0; i < textLen; ++i) {
         if (currentBlockState() != -1 && currentBlockState() % 2 != 0)
@@ -1050,41 +3076,46 @@ void MarkdownHighlighter::highlightSyntax(const QString &text) {
 
         if (i == textLen || !text[i].isLetter()) continue;
 
-        /* Highlight Types */
-        i = applyCodeFormat(i, types, text, formatType);
+        /* Highlight Types, Keywords, Literals (true/false/NULL,nullptr) and
+         * Builtin library stuff, one lookup for the whole word */
+        // check if we are at the beginning OR if this is the start of a word
+        if (i == 0 || (!text.at(i - 1).isLetterOrNumber() &&
+                       text.at(i - 1) != QLatin1Char('_'))) {
+            LanguageData::WordType wordType = LanguageData::NoWord;
+            const int len = langData->matchWord(text, i, wordType);
+            if (len > 0) {
+                const QTextCharFormat *fmt = &formatBuiltIn;
+                switch (wordType) {
+                    case LanguageData::Type:
+                        fmt = &formatType;
+                        break;
+                    case LanguageData::Keyword:
+                        fmt = &formatKeyword;
+                        break;
+                    case LanguageData::Literal:
+                        fmt = &formatNumLit;
+                        break;
+                    default:
+                        break;
+                }
+                setFormat(i, len, *fmt);
+                i += len;
+            }
+        }
         /************************************************
          next letter is usually a space, in that case
          going forward is useless, so continue;
          ************************************************/
         if (i == textLen || !text[i].isLetter()) continue;
 
-        /* Highlight Keywords */
-        i = applyCodeFormat(i, keywords, text, formatKeyword);
-        if (i == textLen || !text[i].isLetter()) continue;
-
-        /* Highlight Literals (true/false/NULL,nullptr) */
-        i = applyCodeFormat(i, literals, text, formatNumLit);
-        if (i == textLen || !text[i].isLetter()) continue;
-
-        /* Highlight Builtin library stuff */
-        i = applyCodeFormat(i, builtin, text, formatBuiltIn);
-        if (i == textLen || !text[i].isLetter()) continue;
-
         /* Highlight other stuff (preprocessor etc.) */
         if (i == 0 || !text.at(i - 1).isLetter()) {
-            const char c = text.at(i).toLatin1();
-            auto it = others.find(c);
-            for (; it != others.end() && it.key() == c; ++it) {
-                const QLatin1String &word = it.value();
-                if (word == MH_SUBSTR(i, word.size()) &&
-                    (i + word.size() == text.length() ||
-                     !text.at(i + word.size()).isLetter())) {
-                    currentBlockState() == CodeCpp ||
-                            currentBlockState() == CodeC
-                        ? setFormat(i - 1, word.size() + 1, formatOther)
-                        : setFormat(i, word.size(), formatOther);
-                    i += word.size();
-                }
+            const int len = langData->matchOther(text, i);
+            if (len > 0) {
+                currentBlockState() == CodeCpp || currentBlockState() == CodeC
+                    ? setFormat(i - 1, len + 1, formatOther)
+                    : setFormat(i, len, formatOther);
+                i += len;
             }
         }
 
@@ -1121,15 +3152,15 @@ void MarkdownHighlighter::highlightSyntax(const QString &text) {
  */
 int MarkdownHighlighter::highlightStringLiterals(QChar strType,
                                                  const QString &text, int i) {
-    const auto &strFormat = _formats[CodeString];
-    setFormat(i, 1, strFormat);
+    const auto &strFormat = textFormat(CodeString);
+    // the string is formatted in one run up to each escape sequence
+    int runStart = i;
     ++i;
 
     while (i < text.length()) {
         // look for string end
         // make sure it's not an escape seq
         if (text.at(i) == strType && text.at(i - 1) != QLatin1Char('\\')) {
-            setFormat(i, 1, strFormat);
             ++i;
             break;
         }
@@ -1194,18 +3225,20 @@ int MarkdownHighlighter::highlightStringLiterals(QChar strType,
             // if len is zero, that means this wasn't an esc seq
             // increment i so that we skip this backslash
             if (len == 0) {
-                setFormat(i, 1, strFormat);
                 ++i;
                 continue;
             }
 
-            setFormat(i, len, _formats[CodeNumLiteral]);
+            setFormat(runStart, i - runStart, strFormat);
+            setFormat(i, len, textFormat(CodeNumLiteral));
             i += len;
+            runStart = i;
             continue;
         }
-        setFormat(i, 1, strFormat);
         ++i;
     }
+
+    setFormat(runStart, i - runStart, strFormat);
     return i - 1;
 }
 
@@ -1254,7 +3287,7 @@ int MarkdownHighlighter::highlightNumericLiterals(const QString &text, int i) {
     const int start = i;
 
     if ((i + 1) >= text.length()) {
-        setFormat(i, 1, _formats[CodeNumLiteral]);
+        setFormat(i, 1, textFormat(CodeNumLiteral));
         return ++i;
     }
 
@@ -1336,7 +3369,7 @@ int MarkdownHighlighter::highlightNumericLiterals(const QString &text, int i) {
     }
     if (isPostfixAllowed) {
         int end = i--;
-        setFormat(start, end - start, _formats[CodeNumLiteral]);
+        setFormat(start, end - start, textFormat(CodeNumLiteral));
     }
     // decrement so that the index is at the last number, not after it
     return i;
@@ -1362,7 +3395,7 @@ void MarkdownHighlighter::taggerScriptHighlighter(const QString &text) {
             MH_SUBSTR(i, 5) != QLatin1String("$noop")) {
             const int next = text.indexOf(QChar('('), i);
             if (next == -1) break;
-            setFormat(i, next - i, _formats[CodeKeyWord]);
+            setFormat(i, next - i, textFormat(CodeKeyWord));
             i = next;
         }
 
@@ -1372,10 +3405,10 @@ void MarkdownHighlighter::taggerScriptHighlighter(const QString &text) {
             const int start = i;
             i++;
             if (next != -1) {
-                setFormat(start, next - start + 1, _formats[CodeType]);
+                setFormat(start, next - start + 1, textFormat(CodeType));
             } else {
                 // error highlighting
-                QTextCharFormat errorFormat = _formats[NoState];
+                QTextCharFormat errorFormat = textFormat(NoState);
                 errorFormat.setUnderlineColor(Qt::red);
                 errorFormat.setUnderlineStyle(QTextCharFormat::WaveUnderline);
                 setFormat(start, 1, errorFormat);
@@ -1386,13 +3419,13 @@ void MarkdownHighlighter::taggerScriptHighlighter(const QString &text) {
         if (MH_SUBSTR(i, 5) == QLatin1String("$noop")) {
             const int next = text.indexOf(QChar(')'), i);
             if (next == -1) break;
-            setFormat(i, next - i + 1, _formats[CodeComment]);
+            setFormat(i, next - i + 1, textFormat(CodeComment));
             i = next;
         }
 
         // highlight escape chars
         if (text.at(i) == QChar('\\')) {
-            setFormat(i, 2, _formats[CodeOther]);
+            setFormat(i, 2, textFormat(CodeOther));
             i++;
         }
     }
@@ -1451,13 +3484,13 @@ void MarkdownHighlighter::ymlHighlighter(const QString &text) {
         if (!colonNotFound) {
             // if the line ends here, format and return
             if (colon + 1 == textLen) {
-                setFormat(i, colon - i, _formats[CodeKeyWord]);
+                setFormat(i, colon - i, textFormat(CodeKeyWord));
                 return;
             }
             // colon is found, check if it isn't some path or something else
             if (!(text.at(colon + 1) == QChar('\\') &&
                   text.at(colon + 1) == QChar('/'))) {
-                setFormat(i, colon - i, _formats[CodeKeyWord]);
+                setFormat(i, colon - i, textFormat(CodeKeyWord));
             }
         }
 
@@ -1466,7 +3499,7 @@ void MarkdownHighlighter::ymlHighlighter(const QString &text) {
             if (MH_SUBSTR(i, 4) == QLatin1String("http")) {
                 int space = text.indexOf(QChar(' '), i);
                 if (space == -1) space = textLen;
-                QTextCharFormat f = _formats[CodeString];
+                QTextCharFormat f = textFormat(CodeString);
                 f.setUnderlineStyle(QTextCharFormat::SingleUnderline);
                 setFormat(i, space - i, f);
                 i = space;
@@ -1502,7 +3535,7 @@ void MarkdownHighlighter::iniHighlighter(const QString &text) {
     for (int i = 0; i < textLen; ++i) {
         // start of a [section]
         if (text.at(i) == QChar('[')) {
-            QTextCharFormat sectionFormat = _formats[CodeType];
+            QTextCharFormat sectionFormat = textFormat(CodeType);
             int sectionEnd = text.indexOf(QChar(']'), i);
             // if an end bracket isn't found, we apply red underline to show
             // error
@@ -1519,14 +3552,14 @@ void MarkdownHighlighter::iniHighlighter(const QString &text) {
 
         // comment ';'
         else if (text.at(i) == QChar(';')) {
-            setFormat(i, textLen - i, _formats[CodeComment]);
+            setFormat(i, textLen - i, textFormat(CodeComment));
             i = textLen;
             break;
         }
 
         // key-val
         else if (text.at(i).isLetter()) {
-            QTextCharFormat format = _formats[CodeKeyWord];
+            QTextCharFormat format = textFormat(CodeKeyWord);
             int equalsPos = text.indexOf(QChar('='), i);
             if (equalsPos == -1) {
                 format.setUnderlineColor(Qt::red);
@@ -1560,7 +3593,7 @@ void MarkdownHighlighter::cssHighlighter(const QString &text) {
                     space = textLen;
                 }
             }
-            setFormat(i, space - i, _formats[CodeKeyWord]);
+            setFormat(i, space - i, textFormat(CodeKeyWord));
             i = space;
         } else if (text[i] == QLatin1Char('c')) {
             if (MH_SUBSTR(i, 5) == QLatin1String("color")) {
@@ -1588,7 +3621,7 @@ void MarkdownHighlighter::cssHighlighter(const QString &text) {
                         const QString b = text.mid(gPos + 1, bPos - (gPos + 1));
                         c.setRgb(r.toInt(), g.toInt(), b.toInt());
                     } else {
-                        c = _formats[HighlighterState::NoState]
+                        c = textFormat(HighlighterState::NoState)
                                 .background()
                                 .color();
                     }
@@ -1615,7 +3648,7 @@ void MarkdownHighlighter::cssHighlighter(const QString &text) {
                     foreground = c.lighter(lightness);
                 }
 
-                QTextCharFormat f = _formats[CodeBlock];
+                QTextCharFormat f = textFormat(CodeBlock);
                 f.setBackground(c);
                 f.setForeground(foreground);
                 // clear prev format
@@ -1631,7 +3664,7 @@ void MarkdownHighlighter::xmlHighlighter(const QString &text) {
     if (text.isEmpty()) return;
     const auto textLen = text.length();
 
-    setFormat(0, textLen, _formats[CodeBlock]);
+    setFormat(0, textLen, textFormat(CodeBlock));
 
     for (int i = 0; i < textLen; ++i) {
         if (i + 1 < textLen && text[i] == QLatin1Char('<') &&
@@ -1640,7 +3673,7 @@ void MarkdownHighlighter::xmlHighlighter(const QString &text) {
             if (found > 0) {
                 ++i;
                 if (text[i] == QLatin1Char('/')) ++i;
-                setFormat(i, found - i, _formats[CodeKeyWord]);
+                setFormat(i, found - i, textFormat(CodeKeyWord));
             }
         }
 
@@ -1649,7 +3682,7 @@ void MarkdownHighlighter::xmlHighlighter(const QString &text) {
             if (lastSpace == i - 1)
                 lastSpace = text.lastIndexOf(QLatin1Char(' '), i - 2);
             if (lastSpace > 0) {
-                setFormat(lastSpace, i - lastSpace, _formats[CodeBuiltIn]);
+                setFormat(lastSpace, i - lastSpace, textFormat(CodeBuiltIn));
             }
         }
 
@@ -1673,7 +3706,7 @@ void MarkdownHighlighter::xmlHighlighter(const QString &text) {
                     break;
                 }
             }
-            setFormat(pos, cnt, _formats[CodeString]);
+            setFormat(pos, cnt, textFormat(CodeString));
         }
     }
 }
@@ -1681,7 +3714,7 @@ void MarkdownHighlighter::xmlHighlighter(const QString &text) {
 void MarkdownHighlighter::makeHighlighter(const QString &text) {
     const int colonPos = text.indexOf(QLatin1Char(':'));
     if (colonPos == -1) return;
-    setFormat(0, colonPos, _formats[CodeBuiltIn]);
+    setFormat(0, colonPos, textFormat(CodeBuiltIn));
 }
 
 /**
@@ -1698,14 +3731,14 @@ void MarkdownHighlighter::forthHighlighter(const QString &text) {
     const auto textLen = text.length();
 
     // Default Format
-    setFormat(0, textLen, _formats[CodeBlock]);
+    setFormat(0, textLen, textFormat(CodeBlock));
 
     for (int i = 0; i < textLen; ++i) {
         // 1, It highlights the "\ " comments
         if (i + 1 <= textLen && text[i] == QLatin1Char('\\') &&
             text[i + 1] == QLatin1Char(' ')) {
             // The full line is commented
-            setFormat(i + 1, textLen - 1, _formats[CodeComment]);
+            setFormat(i + 1, textLen - 1, textFormat(CodeComment));
             break;
         }
         // 2. It highlights the "( " comments
@@ -1718,7 +3751,7 @@ void MarkdownHighlighter::forthHighlighter(const QString &text) {
             // ' )' at the end of the comment
             if (lastBracket <= textLen &&
                 text[lastBracket] == QLatin1Char(' ')) {
-                setFormat(i, lastBracket, _formats[CodeComment]);
+                setFormat(i, lastBracket, textFormat(CodeComment));
             }
         }
     }
@@ -1745,10 +3778,10 @@ void MarkdownHighlighter::gdscriptHighlighter(const QString &text) {
         // 3. Hightlight '@' annotation symbol
         if (match.captured().startsWith(QLatin1Char('@'))) {
             setFormat(match.capturedStart(), match.capturedLength(),
-                      _formats[CodeOther]);
+                      textFormat(CodeOther));
         } else {
             setFormat(match.capturedStart(), match.capturedLength(),
-                      _formats[CodeNumLiteral]);
+                      textFormat(CodeNumLiteral));
         }
     }
 }
@@ -1770,7 +3803,7 @@ void MarkdownHighlighter::sqlHighlighter(const QString &text) {
         }
         // Check for comments: single-line, or multi-line start or end
         if (text[i] == QLatin1Char('-') && text[i + 1] == QLatin1Char('-')) {
-            setFormat(i, textLen, _formats[CodeComment]);
+            setFormat(i, textLen, textFormat(CodeComment));
         } else if (text[i] == QLatin1Char('/') &&
                    text[i + 1] == QLatin1Char('*')) {
             // we're in a multi-line comment now
@@ -1783,7 +3816,7 @@ void MarkdownHighlighter::sqlHighlighter(const QString &text) {
                     highlightEnd = endingComment + 2;
                 }
 
-                setFormat(i, highlightEnd - i, _formats[CodeComment]);
+                setFormat(i, highlightEnd - i, textFormat(CodeComment));
             }
         } else if (text[i] == QLatin1Char('*') &&
                    text[i + 1] == QLatin1Char('/')) {
@@ -1797,7 +3830,7 @@ void MarkdownHighlighter::sqlHighlighter(const QString &text) {
                     highlightStart = startingComment;
                 }
 
-                setFormat(highlightStart - i, i + 1, _formats[CodeComment]);
+                setFormat(highlightStart - i, i + 1, textFormat(CodeComment));
             }
         }
     }
@@ -1841,7 +3874,7 @@ void MarkdownHighlighter::tomlHighlighter(const QString &text) {
                         text.indexOf(QLatin1String("\"\"\""), i + 1);
                     if (multiDoubleQStringEnd > -1) {
                         setFormat(i, multiDoubleQStringEnd - i,
-                                  _formats[CodeString]);
+                                  textFormat(CodeString));
                         i = multiDoubleQStringEnd + 2;
                         multiDoubleQStringEnd = -1;
                         multiDoubleQStringStart = -1;
@@ -1866,7 +3899,7 @@ void MarkdownHighlighter::tomlHighlighter(const QString &text) {
                         text.indexOf(QLatin1String("'''"), i + 1);
                     if (multiSingleQStringEnd > -1) {
                         setFormat(i, multiSingleQStringEnd - i,
-                                  _formats[CodeString]);
+                                  textFormat(CodeString));
                         i = multiSingleQStringEnd + 2;
                         multiSingleQStringEnd = -1;
                         multiSingleQStringStart = -1;
@@ -1888,7 +3921,7 @@ void MarkdownHighlighter::tomlHighlighter(const QString &text) {
 
         // do comment highlighting
         if (text[i] == QLatin1Char('#') && !inString) {
-            setFormat(i, textLen - i, _formats[CodeComment]);
+            setFormat(i, textLen - i, textFormat(CodeComment));
             return;
         }
 
@@ -1896,7 +3929,7 @@ void MarkdownHighlighter::tomlHighlighter(const QString &text) {
         if (text[i] == QLatin1Char('[') && onlyWhitespaceBeforeHeader) {
             int headerEnd = text.indexOf(QLatin1Char(']'), i);
             if (headerEnd > -1) {
-                setFormat(i, headerEnd + 1 - i, _formats[CodeType]);
+                setFormat(i, headerEnd + 1 - i, textFormat(CodeType));
                 return;
             }
         }
@@ -1921,7 +3954,7 @@ void MarkdownHighlighter::tomlHighlighter(const QString &text) {
                 }
             }
             setFormat(highlightStart, endOfNumber - highlightStart,
-                      _formats[CodeNumLiteral]);
+                      textFormat(CodeNumLiteral));
             i = endOfNumber;
         }
 
@@ -1943,19 +3976,19 @@ void MarkdownHighlighter::highlightFrontmatterBlock(const QString &text) {
 
         // return if the frontmatter block was already highlighted in previous
         // blocks, there just can be one frontmatter block
-        if (!foundEnd && document()->firstBlock() != currentBlock()) {
+        if (!foundEnd && !isFirstBlock()) {
             return;
         }
 
         setCurrentBlockState(foundEnd ? HighlighterState::FrontmatterBlockEnd
                                       : HighlighterState::FrontmatterBlock);
 
-        QTextCharFormat &maskedFormat =
-            _formats[HighlighterState::MaskedSyntax];
+        const QTextCharFormat &maskedFormat =
+            textFormat(HighlighterState::MaskedSyntax);
         setFormat(0, text.length(), maskedFormat);
     } else if (previousBlockState() == HighlighterState::FrontmatterBlock) {
         setCurrentBlockState(HighlighterState::FrontmatterBlock);
-        setFormat(0, text.length(), _formats[HighlighterState::MaskedSyntax]);
+        setFormat(0, text.length(), textFormat(HighlighterState::MaskedSyntax));
     }
 }
 
@@ -1990,7 +4023,7 @@ void MarkdownHighlighter::highlightCommentBlock(const QString &text) {
     const bool highlight = isComment || isCommentEnd;
 
     if (isComment) setCurrentBlockState(Comment);
-    if (highlight) setFormat(0, text.length(), _formats[Comment]);
+    if (highlight) setFormat(0, text.length(), textFormat(Comment));
 }
 
 /**
@@ -2020,7 +4053,7 @@ void MarkdownHighlighter::highlightThematicBreak(const QString &text) {
     }
     if (len < 3) return;
 
-    if (hasSameChars) setFormat(0, text.length(), _formats[HorizontalRuler]);
+    if (hasSameChars) setFormat(0, text.length(), textFormat(HorizontalRuler));
 }
 
 void MarkdownHighlighter::highlightCheckbox(const QString &text, int curPos) {
@@ -2043,7 +4076,7 @@ void MarkdownHighlighter::highlightCheckbox(const QString &text, int curPos) {
                                                             : CheckBoxChecked)
                              : MaskedSyntax;
 
-        setFormat(start, length, _formats[fmt]);
+        setFormat(start, length, textFormat(fmt));
     }
 }
 
@@ -2057,6 +4090,8 @@ static bool isBeginningOfList(QChar front) {
  * @param text - current text block
  */
 void MarkdownHighlighter::highlightLists(const QString &text) {
+    MH_MEASURE_PHASE(ListsPhase, text);
+
     int spaces = 0;
     // Skip any spaces in the beginning
     while (spaces < text.length() && text.at(spaces).isSpace()) ++spaces;
@@ -2087,7 +4122,7 @@ void MarkdownHighlighter::highlightLists(const QString &text) {
              text.at(number) == QLatin1Char(')')) &&
             (text.at(number + 1) == QLatin1Char(' '))) {
             setCurrentBlockState(List);
-            setFormat(curPos, number - curPos + 1, _formats[List]);
+            setFormat(curPos, number - curPos + 1, textFormat(List));
 
             // highlight checkbox if any
             highlightCheckbox(text, number);
@@ -2107,7 +4142,7 @@ void MarkdownHighlighter::highlightLists(const QString &text) {
 
     /* Unordered List */
     setCurrentBlockState(List);
-    setFormat(curPos, 1, _formats[List]);
+    setFormat(curPos, 1, textFormat(List));
 }
 
 /**
@@ -2121,10 +4156,10 @@ void MarkdownHighlighter::setHeadingStyles(HighlighterState rule,
                                            const QRegularExpressionMatch &match,
                                            const int capturedGroup) {
     auto state = static_cast<HighlighterState>(currentBlockState());
-    const QTextCharFormat &f = _formats[state];
+    const QTextCharFormat &f = textFormat(state);
 
     if (rule == HighlighterState::Link) {
-        auto linkFmt = _formats[Link];
+        auto linkFmt = textFormat(Link);
         linkFmt.setFontPointSize(f.fontPointSize());
         if (capturedGroup == 1) {
             setFormat(match.capturedStart(capturedGroup),
@@ -2135,26 +4170,90 @@ void MarkdownHighlighter::setHeadingStyles(HighlighterState rule,
 }
 
 /**
- * Highlights the rules from the _highlightingRules list
+ * Finds the shouldContain literals of the (first 64) rules in one pass over
+ * the text, at every position only the literals starting with the current
+ * character are compared
+ *
+ * @param rules
+ * @param text
+ * @return a bit for every rule whose literal is in the text
+ */
+quint64 MarkdownHighlighter::findRuleLiterals(
+    const QVector<HighlightingRule> &rules, const QString &text) {
+    const int ruleCount = qMin(int(rules.size()), maxPrefilteredRules);
+    quint64 found = 0;
+    quint64 pending = 0;
+    // bit map of the (ASCII) first characters of the literals
+    quint64 firstChars[2] = {0, 0};
+
+    for (int i = 0; i < ruleCount; ++i) {
+        const QString &literal = rules.at(i).shouldContain;
+        const quint64 bit = quint64(1) << i;
+
+        if (literal.isEmpty()) {
+            found |= bit;
+        } else if (literal.at(0).unicode() >= 128) {
+            if (text.contains(literal)) found |= bit;
+        } else {
+            const ushort c = literal.at(0).unicode();
+            firstChars[c >> 6] |= quint64(1) << (c & 63);
+            pending |= bit;
+        }
+    }
+
+    const int textLen = text.length();
+    for (int pos = 0; pos < textLen && pending != 0; ++pos) {
+        const ushort c = text.at(pos).unicode();
+        if (c >= 128 || !(firstChars[c >> 6] & (quint64(1) << (c & 63))))
+            continue;
+
+        for (int i = 0; i < ruleCount; ++i) {
+            const quint64 bit = quint64(1) << i;
+            if (!(pending & bit)) continue;
+
+            const QString &literal = rules.at(i).shouldContain;
+            if (literal.at(0).unicode() == c &&
+                MH_SUBSTR(pos, literal.length()) == literal) {
+                found |= bit;
+                pending &= ~bit;
+            }
+        }
+    }
+
+    return found;
+}
+
+/**
+ * Highlights the rules from the highlighting rules list
  *
  * @param text
  */
 void MarkdownHighlighter::highlightAdditionalRules(
     const QVector<HighlightingRule> &rules, const QString &text) {
-    const auto &maskedFormat = _formats[HighlighterState::MaskedSyntax];
+    MH_MEASURE_PHASE(AdditionalRulesPhase, text);
+
+    const auto &maskedFormat = textFormat(HighlighterState::MaskedSyntax);
+
+    // only the rules whose literal is in the text need their pattern matched
+    const quint64 containedRules = findRuleLiterals(rules, text);
+
+    for (int ruleIndex = 0; ruleIndex < rules.size(); ++ruleIndex) {
+        const HighlightingRule &rule = rules.at(ruleIndex);
 
-    for (const HighlightingRule &rule : rules) {
         // continue if another current block state was already set if
         // disableIfCurrentStateIsSet is set
         if (currentBlockState() != NoState) continue;
 
-        const bool contains = text.contains(rule.shouldContain);
+        const bool contains =
+            ruleIndex < maxPrefilteredRules
+                ? containedRules & (quint64(1) << ruleIndex)
+                : text.contains(rule.shouldContain);
         if (!contains) continue;
 
         auto iterator = rule.pattern.globalMatch(text);
         const uint8_t capturingGroup = rule.capturingGroup;
         const uint8_t maskedGroup = rule.maskedGroup;
-        const QTextCharFormat &format = _formats[rule.state];
+        const QTextCharFormat &format = textFormat(rule.state);
 
         // find and format all occurrences
         while (iterator.hasNext()) {
@@ -2216,14 +4315,23 @@ int isInLinkRange(int pos, QVector<QPair<int, int>> &range) {
  * underlines, strikethrough, links, and images.
  */
 void MarkdownHighlighter::highlightInlineRules(const QString &text) {
+    MH_MEASURE_PHASE(InlineRulesPhase, text);
+
     // clear existing span ranges for this block
-    auto it = _ranges.find(currentBlock().blockNumber());
-    if (it != _ranges.end()) {
-        it->clear();
-    }
+    currentBlockRanges().clear();
+
+    // only the positions of the characters the stages below react to are
+    // visited, the same check as in highlightLinkOrImage() for every
+    // position would be a no-op
+    classifyInlineCharacters(text, _inlinePositions, _emphasisPositions);
+    const bool linksAllowed = areLinksAllowed(text);
+    int next = 0;
 
-    for (int i = 0; i < text.length(); ++i) {
-        QChar currentChar = text.at(i);
+    for (const int position : _inlinePositions) {
+        if (position < next) continue;
+
+        int i = position;
+        const QChar currentChar = text.at(i);
 
         if (currentChar == QLatin1Char('`') ||
             currentChar == QLatin1Char('~')) {
@@ -2231,30 +4339,38 @@ void MarkdownHighlighter::highlightInlineRules(const QString &text) {
         } else if (currentChar == QLatin1Char('<') &&
                    MH_SUBSTR(i, 4) == QLatin1String("<!--")) {
             i = highlightInlineComment(text, i);
-        } else {
+        } else if (linksAllowed) {
             i = highlightLinkOrImage(text, i);
         }
+
+        next = i + 1;
     }
 
     highlightEmAndStrong(text, 0);
 }
 
-// Helper function for MarkdownHighlighter::highlightLinkOrImage
-bool isLink(const QString &text) {
-    static const QLatin1String supportedSchemes[] = {
-        QLatin1String("http://"),  QLatin1String("https://"),
-        QLatin1String("file://"),  QLatin1String("www."),
-        QLatin1String("ftp://"),   QLatin1String("mailto:"),
-        QLatin1String("tel:"),     QLatin1String("sms:"),
-        QLatin1String("smsto:"),   QLatin1String("data:"),
-        QLatin1String("irc://"),   QLatin1String("gopher://"),
-        QLatin1String("spotify:"), QLatin1String("steam:"),
-        QLatin1String("bitcoin:"), QLatin1String("magnet:"),
-        QLatin1String("ed2k://"),  QLatin1String("news:"),
-        QLatin1String("ssh://"),   QLatin1String("note://")};
+static const QLatin1String supportedSchemes[] = {
+    QLatin1String("http://"),  QLatin1String("https://"),
+    QLatin1String("file://"),  QLatin1String("www."),
+    QLatin1String("ftp://"),   QLatin1String("mailto:"),
+    QLatin1String("tel:"),     QLatin1String("sms:"),
+    QLatin1String("smsto:"),   QLatin1String("data:"),
+    QLatin1String("irc://"),   QLatin1String("gopher://"),
+    QLatin1String("spotify:"), QLatin1String("steam:"),
+    QLatin1String("bitcoin:"), QLatin1String("magnet:"),
+    QLatin1String("ed2k://"),  QLatin1String("news:"),
+    QLatin1String("ssh://"),   QLatin1String("note://")};
+
+/**
+ * Returns true if a part of the text starts with a supported link scheme,
+ * without copying it
+ */
+static bool startsWithLinkScheme(const QString &text, int position,
+                                 int length) {
+    const auto link = MH_SUBSTR(position, length);
 
     for (const QLatin1String &scheme : supportedSchemes) {
-        if (text.startsWith(scheme)) {
+        if (link.startsWith(scheme)) {
             return true;
         }
     }
@@ -2262,6 +4378,116 @@ bool isLink(const QString &text) {
     return false;
 }
 
+// Helper function for MarkdownHighlighter::highlightLinkOrImage
+bool isLink(const QString &text) {
+    return startsWithLinkScheme(text, 0, text.length());
+}
+
+enum InlineCharacterClass : quint8 {
+    // characters highlightInlineRules() looks at
+    InlineCharacter = 0x01,
+    // characters highlightEmAndStrong() looks at
+    EmphasisCharacter = 0x02
+};
+
+/**
+ * Returns the classes of the ASCII characters
+ */
+static const quint8 *inlineCharacterClasses() {
+    static const struct Table {
+        quint8 classes[128] = {};
+
+        Table() {
+            classes['`'] = classes['~'] = InlineCharacter;
+            classes['<'] = classes['['] = InlineCharacter;
+            // links and "href" attributes
+            classes['h'] = InlineCharacter;
+            for (const QLatin1String &scheme : supportedSchemes) {
+                classes[static_cast<uchar>(scheme.at(0).toLatin1())] =
+                    InlineCharacter;
+            }
+
+            classes['*'] = classes['_'] = EmphasisCharacter;
+        }
+    } table;
+
+    return table.classes;
+}
+
+/**
+ * Collects the positions of the characters the inline highlighting stages
+ * react to in one pass over the text
+ *
+ * @param text
+ * @param inlinePositions positions for highlightInlineRules()
+ * @param emphasisPositions positions for highlightEmAndStrong()
+ */
+void MarkdownHighlighter::classifyInlineCharacters(
+    const QString &text, QVector<int> &inlinePositions,
+    QVector<int> &emphasisPositions) {
+    inlinePositions.clear();
+    emphasisPositions.clear();
+
+    const quint8 *classes = inlineCharacterClasses();
+    const QChar *data = text.constData();
+    const int length = text.length();
+
+    for (int i = 0; i < length; ++i) {
+        const ushort c = data[i].unicode();
+        if (c >= 128) continue;
+
+        const quint8 characterClass = classes[c];
+        if (characterClass == 0) continue;
+
+        if (characterClass == InlineCharacter) {
+            inlinePositions.append(i);
+        } else {
+            emphasisPositions.append(i);
+        }
+    }
+}
+
+/**
+ * Returns true if links are highlighted in a line, which isn't the case for
+ * indented code, unless it is a list item
+ *
+ * @param text
+ * @return
+ */
+bool MarkdownHighlighter::areLinksAllowed(const QString &text) {
+    const int length = text.length();
+    const int prefixLength = qMin(4, length);
+
+    for (int i = 0; i < prefixLength; ++i) {
+        if (!text.at(i).isSpace()) return true;
+    }
+
+    int begin = 0;
+    while (begin < length && text.at(begin).isSpace()) ++begin;
+    int end = length;
+    while (end > begin && text.at(end - 1).isSpace()) --end;
+
+    // unordered list markers
+    if (end - begin >= 2 && text.at(begin + 1) == QLatin1Char(' ')) {
+        const QChar marker = text.at(begin);
+        if (marker == QLatin1Char('-') || marker == QLatin1Char('+') ||
+            marker == QLatin1Char('*')) {
+            return true;
+        }
+    }
+
+    // ordered list markers like "1. " or "12) "
+    int i = begin;
+    while (i < end && text.at(i) >= QLatin1Char('0') &&
+           text.at(i) <= QLatin1Char('9')) {
+        ++i;
+    }
+
+    return i > begin && i + 1 < end &&
+           (text.at(i) == QLatin1Char('.') || text.at(i) == QLatin1Char(')')) &&
+           text.at(i + 1) == QLatin1Char(' ');
+}
+
 bool isValidEmail(const QString &email) {
     // Check for a single '@' character
     int atIndex = email.indexOf('@');
@@ -2288,9 +4514,9 @@ void MarkdownHighlighter::formatAndMaskRemaining(
     const QTextCharFormat &format) {
     int afterFormat = formatBegin + formatLength;
 
-    auto maskedSyntax = _formats[MaskedSyntax];
+    auto maskedSyntax = textFormat(MaskedSyntax);
     maskedSyntax.setFontPointSize(
-        QSyntaxHighlighter::format(beginningText).fontPointSize());
+        MarkdownHighlighter::format(beginningText).fontPointSize());
 
     // highlight before the link
     setFormat(beginningText, formatBegin - beginningText, maskedSyntax);
@@ -2302,17 +4528,17 @@ void MarkdownHighlighter::formatAndMaskRemaining(
 
     // highlight after the link
     maskedSyntax.setFontPointSize(
-        QSyntaxHighlighter::format(afterFormat).fontPointSize());
+        MarkdownHighlighter::format(afterFormat).fontPointSize());
     setFormat(afterFormat, endText - afterFormat, maskedSyntax);
 
-    _ranges[currentBlock().blockNumber()].append(
-        InlineRange(beginningText, formatBegin, RangeType::Link));
-    _ranges[currentBlock().blockNumber()].append(
-        InlineRange(afterFormat, endText, RangeType::Link));
+    QVector<InlineRange> &ranges = currentBlockRanges();
+    ranges.append(InlineRange(beginningText, formatBegin, RangeType::Link));
+    ranges.append(InlineRange(afterFormat, endText, RangeType::Link));
 }
 
 /**
  * @brief This function highlights images and links in Markdown text.
+ * It is only called for lines where areLinksAllowed() is true.
  *
  * @param text The input Markdown text.
  * @param startIndex The starting index from where to begin processing.
@@ -2320,54 +4546,6 @@ void MarkdownHighlighter::formatAndMaskRemaining(
  */
 int MarkdownHighlighter::highlightLinkOrImage(const QString &text,
                                               int startIndex) {
-    // If the first 4 characters are spaces (for 4-spaces fence code),
-    // but not list markers, return
-    if (text.left(4).trimmed().isEmpty()) {
-        // Check for unordered list markers
-        auto leftChars = text.trimmed().left(2);
-
-        if (leftChars != QLatin1String("- ") &&
-            leftChars != QLatin1String("+ ") &&
-            leftChars != QLatin1String("* ")) {
-            // Check for a few ordered list markers
-            leftChars = text.trimmed().left(3);
-
-            if (leftChars != QLatin1String("1) ") &&
-                leftChars != QLatin1String("2) ") &&
-                leftChars != QLatin1String("3) ") &&
-                leftChars != QLatin1String("4) ") &&
-                leftChars != QLatin1String("5) ") &&
-                leftChars != QLatin1String("6) ") &&
-                leftChars != QLatin1String("7) ") &&
-                leftChars != QLatin1String("8) ") &&
-                leftChars != QLatin1String("9) ") &&
-                leftChars != QLatin1String("1. ") &&
-                leftChars != QLatin1String("2. ") &&
-                leftChars != QLatin1String("3. ") &&
-                leftChars != QLatin1String("4. ") &&
-                leftChars != QLatin1String("5. ") &&
-                leftChars != QLatin1String("6. ") &&
-                leftChars != QLatin1String("7. ") &&
-                leftChars != QLatin1String("8. ") &&
-                leftChars != QLatin1String("9. ")) {
-                // Check if text starts with a "\d+. ", "\d+) "
-                const static QStringList patterns = {"\\d+\\. ", "\\d+\\) "};
-
-                // Construct the regular expression pattern
-                const static QString patternString =
-                    "^(" + patterns.join("|") + ")";
-                const static QRegularExpression pattern(patternString);
-
-                // Check if the text starts with any of the specified patterns
-                QRegularExpressionMatch match = pattern.match(text.trimmed());
-
-                if (!match.hasMatch()) {
-                    return startIndex;
-                }
-            }
-        }
-    }
-
     // Get the character at the starting index
     QChar startChar = text.at(startIndex);
 
@@ -2389,7 +4567,7 @@ int MarkdownHighlighter::highlightLinkOrImage(const QString &text,
 
         // Apply formatting to highlight the link
         formatAndMaskRemaining(startIndex + 1, closingChar - startIndex - 1,
-                               startIndex, closingChar + 1, _formats[Link]);
+                               startIndex, closingChar + 1, textFormat(Link));
 
         return closingChar;
     }
@@ -2403,20 +4581,20 @@ int MarkdownHighlighter::highlightLinkOrImage(const QString &text,
             int hrefEnd = text.indexOf(QLatin1Char('"'), startIndex + 6);
             if (hrefEnd == -1) return space;
 
-            _ranges[currentBlock().blockNumber()].append(
+            currentBlockRanges().append(
                 InlineRange(startIndex + 6, hrefEnd, RangeType::Link));
-            setFormat(startIndex + 6, hrefEnd - startIndex - 6, _formats[Link]);
+            setFormat(startIndex + 6, hrefEnd - startIndex - 6, textFormat(Link));
             return hrefEnd;
         }
 
-        QString link = text.mid(startIndex, space - startIndex - 1);
-        if (!isLink(link)) return startIndex;
-
-        auto linkLength = link.length();
+        const int linkLength = space - startIndex - 1;
+        if (!startsWithLinkScheme(text, startIndex, linkLength)) {
+            return startIndex;
+        }
 
-        _ranges[currentBlock().blockNumber()].append(
+        currentBlockRanges().append(
             InlineRange(startIndex, startIndex + linkLength, RangeType::Link));
-        setFormat(startIndex, linkLength + 1, _formats[Link]);
+        setFormat(startIndex, linkLength + 1, textFormat(Link));
         return space;
     }
 
@@ -2436,7 +4614,7 @@ int MarkdownHighlighter::highlightLinkOrImage(const QString &text,
 
         // Apply formatting to highlight the image.
         formatAndMaskRemaining(startIndex + 1, endIndex - startIndex - 1,
-                               startIndex - 1, closingIndex, _formats[Image]);
+                               startIndex - 1, closingIndex, textFormat(Image));
         return closingIndex;
     }
     // If the character after the closing ']' is '(', it's a regular link
@@ -2460,14 +4638,14 @@ int MarkdownHighlighter::highlightLinkOrImage(const QString &text,
             ++hrefIndex;
 
             formatAndMaskRemaining(startIndex + 3, endIndex - startIndex - 3,
-                                   startIndex, hrefIndex, _formats[Link]);
+                                   startIndex, hrefIndex, textFormat(Link));
 
             return hrefIndex;
         }
 
         // Apply formatting to highlight the link
         formatAndMaskRemaining(startIndex + 1, endIndex - startIndex - 1,
-                               startIndex, closingParenIndex, _formats[Link]);
+                               startIndex, closingParenIndex, textFormat(Link));
         return closingParenIndex;
     }
     // Reference links
@@ -2484,7 +4662,7 @@ int MarkdownHighlighter::highlightLinkOrImage(const QString &text,
         ++closingChar;
 
         formatAndMaskRemaining(startIndex + 1, endIndex - startIndex - 1,
-                               origIndex, closingChar, _formats[Link]);
+                               origIndex, closingChar, textFormat(Link));
         return closingChar;
     }
     // If the character after the closing ']' is ':', it's a reference link
@@ -2543,11 +4721,11 @@ int MarkdownHighlighter::highlightInlineSpans(const QString &text,
 
     // get existing format if any
     // we want to append to the existing format, not overwrite it
-    QTextCharFormat fmt = QSyntaxHighlighter::format(start + 1);
+    QTextCharFormat fmt = format(start + 1);
     QTextCharFormat inlineFmt;
 
     // select appropriate format for current text
-    if (c != QLatin1Char('~')) inlineFmt = _formats[InlineCodeBlock];
+    if (c != QLatin1Char('~')) inlineFmt = textFormat(InlineCodeBlock);
 
     // make sure we don't change font size / existing formatting
     if (fmt.fontPointSize() > 0)
@@ -2563,7 +4741,7 @@ int MarkdownHighlighter::highlightInlineSpans(const QString &text,
     }
 
     if (c == QLatin1Char('`')) {
-        _ranges[currentBlock().blockNumber()].append(
+        currentBlockRanges().append(
             InlineRange(start, next, RangeType::CodeSpan));
     }
 
@@ -2571,8 +4749,8 @@ int MarkdownHighlighter::highlightInlineSpans(const QString &text,
     setFormat(start + len, next - (start + len), inlineFmt);
 
     // format backticks as masked
-    setFormat(start, len, _formats[MaskedSyntax]);
-    setFormat(next, len, _formats[MaskedSyntax]);
+    setFormat(start, len, textFormat(MaskedSyntax));
+    setFormat(next, len, textFormat(MaskedSyntax));
 
     i = next + len;
     return i;
@@ -2594,7 +4772,7 @@ int MarkdownHighlighter::highlightInlineComment(const QString &text, int pos) {
     if (commentEnd == -1) return pos;
 
     commentEnd += 3;
-    setFormat(start, commentEnd - start, _formats[Comment]);
+    setFormat(start, commentEnd - start, textFormat(Comment));
     return commentEnd - 1;
 }
 
@@ -2718,60 +4896,346 @@ void balancePairs(QVector<Delimiter> &delims) {
     }
 }
 
+MarkdownHighlighter::BlockData::BlockData(QVector<InlineRange> ranges,
+                                          bool codeBlockFence_,
+                                          bool rightToLeft_)
+    : codeBlockFence(codeBlockFence_), rightToLeft(rightToLeft_) {
+    std::stable_sort(ranges.begin(), ranges.end(),
+                     [](const InlineRange &a, const InlineRange &b) {
+                         return a.begin < b.begin;
+                     });
+
+    bool fitsShort = true;
+    for (const InlineRange &range : ranges) {
+        if (range.begin < 0 || range.end < 0 ||
+            range.end > std::numeric_limits<quint16>::max()) {
+            fitsShort = false;
+            break;
+        }
+    }
+
+    if (fitsShort) {
+        pack(ranges, shortRanges);
+    } else {
+        pack(ranges, longRanges);
+    }
+}
+
+template <typename Offset>
+void MarkdownHighlighter::BlockData::pack(
+    const QVector<InlineRange> &ranges, QVector<PackedRange<Offset>> &packed) {
+    packed.reserve(ranges.size());
+    int maxEnd = -1;
+    for (const InlineRange &range : ranges) {
+        maxEnd = qMax(maxEnd, range.end);
+        const PackedRange<Offset> packedRange = {
+            static_cast<Offset>(range.begin), static_cast<Offset>(range.end),
+            static_cast<Offset>(maxEnd), static_cast<quint8>(range.type)};
+        packed.append(packedRange);
+    }
+}
+
+/**
+ * Returns the inline ranges of the block, sorted by their begin
+ *
+ * @return
+ */
+QVector<MarkdownHighlighter::InlineRange>
+MarkdownHighlighter::BlockData::inlineRanges() const {
+    QVector<InlineRange> ranges;
+    ranges.reserve(shortRanges.size() + longRanges.size());
+
+    for (const auto &range : shortRanges) {
+        ranges.append(InlineRange(range.begin, range.end,
+                                  static_cast<RangeType>(range.type)));
+    }
+    for (const auto &range : longRanges) {
+        ranges.append(InlineRange(range.begin, range.end,
+                                  static_cast<RangeType>(range.type)));
+    }
+
+    return ranges;
+}
+
+/**
+ * Returns the bytes allocated for the data
+ *
+ * @return
+ */
+qint64 MarkdownHighlighter::BlockData::memoryUsage() const {
+    qint64 bytes = sizeof(BlockData) +
+                   shortRanges.capacity() * sizeof(PackedRange<quint16>) +
+                   longRanges.capacity() * sizeof(PackedRange<qint32>) +
+                   references.capacity() * sizeof(QPair<QString, QString>);
+
+    for (const auto &reference : references) {
+        bytes += (reference.first.capacity() + reference.second.capacity()) *
+                 sizeof(QChar);
+    }
+
+    return bytes;
+}
+
+/**
+ * Finds a range of a type that contains a position
+ *
+ * @param type
+ * @param position
+ * @param atBorder if true the position must be the begin or the end of the
+ * range, otherwise it must be inside of it
+ * @param range gets the range if it is not null
+ * @return true if there is such a range
+ */
+bool MarkdownHighlighter::BlockData::find(RangeType type, int position,
+                                          bool atBorder,
+                                          InlineRange *range) const {
+    return shortRanges.isEmpty()
+               ? find(longRanges, type, position, atBorder, range)
+               : find(shortRanges, type, position, atBorder, range);
+}
+
+template <typename Offset>
+bool MarkdownHighlighter::BlockData::find(
+    const QVector<PackedRange<Offset>> &ranges, RangeType type, int position,
+    bool atBorder, InlineRange *range) {
+    using Range = PackedRange<Offset>;
+
+    // only ranges beginning in front of the position (or at it) can contain it
+    const auto it =
+        atBorder ? std::upper_bound(ranges.cbegin(), ranges.cend(), position,
+                                    [](int pos, const Range &packed) {
+                                        return pos < int(packed.begin);
+                                    })
+                 : std::lower_bound(ranges.cbegin(), ranges.cend(), position,
+                                    [](const Range &packed, int pos) {
+                                        return int(packed.begin) < pos;
+                                    });
+
+    for (int i = int(it - ranges.cbegin()) - 1; i >= 0; --i) {
+        const Range &packed = ranges.at(i);
+
+        // no range up to here reaches the position anymore
+        const int maxEnd = packed.maxEnd;
+        if (maxEnd < position || (!atBorder && maxEnd == position)) break;
+
+        if (packed.type != static_cast<quint8>(type)) continue;
+
+        const int begin = packed.begin;
+        const int end = packed.end;
+        if (atBorder ? position == begin || position == end
+                     : position > begin && position < end) {
+            if (range) *range = InlineRange(begin, end, type);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Stores the inline ranges and the properties the editor needs for painting
+ * with the current block, after its state was set
+ *
+ * @param text
+ * @param ranges
+ */
+void MarkdownHighlighter::setCurrentBlockData(
+    const QString &text, const QVector<InlineRange> &ranges) {
+    // the opening and closing fences don't get a code block background
+    const bool codeBlockFence =
+        isCodeBlock(currentBlockState()) &&
+        (text.startsWith(QLatin1String("```")) ||
+         text.startsWith(QLatin1String("~~~")));
+    const bool rightToLeft = text.isRightToLeft();
+    QVector<QPair<QString, QString>> references;
+
+    if (text.contains(QLatin1String("]: "))) {
+        static const QRegularExpression regex(
+            QStringLiteral(R"(\[([^\[\]]+)\]: (.+))"));
+        QRegularExpressionMatchIterator iterator = regex.globalMatch(text);
+
+        while (iterator.hasNext()) {
+            const QRegularExpressionMatch match = iterator.next();
+            references.append({match.captured(1), match.captured(2)});
+        }
+    }
+
+    const QTextBlock block = currentBlock();
+    const auto *oldData =
+        static_cast<const BlockData *>(currentBlockUserData());
+    const QVector<QPair<QString, QString>> oldReferences =
+        oldData ? oldData->references : QVector<QPair<QString, QString>>();
+    if (!oldReferences.isEmpty() || !references.isEmpty()) {
+        updateReferenceIndex(block, oldReferences, references);
+    }
+
+    // most blocks don't need any data
+    if (ranges.isEmpty() && !codeBlockFence && !rightToLeft &&
+        references.isEmpty()) {
+        if (oldData) setCurrentBlockUserData(nullptr);
+        return;
+    }
+
+    // the previous data will be deleted by the block
+    auto *data = new BlockData(ranges, codeBlockFence, rightToLeft);
+    data->references = std::move(references);
+    setCurrentBlockUserData(data);
+}
+
+/**
+ * Updates the blocks of the reference ids that were removed from or added
+ * to a block
+ *
+ * @param block
+ * @param oldReferences
+ * @param newReferences
+ */
+void MarkdownHighlighter::updateReferenceIndex(
+    const QTextBlock &block,
+    const QVector<QPair<QString, QString>> &oldReferences,
+    const QVector<QPair<QString, QString>> &newReferences) {
+    // the blocks of another (maybe deleted) document must not be touched
+    if (_referenceDocument != document()) {
+        _referenceBlocks.clear();
+        _referenceDocument = document();
+    }
+
+    for (const auto &reference : oldReferences) {
+        auto it = _referenceBlocks.find(reference.first);
+        if (it == _referenceBlocks.end()) continue;
+
+        QVector<QTextBlock> &blocks = it.value();
+        blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                                    [&block](const QTextBlock &b) {
+                                        return b == block || !b.isValid();
+                                    }),
+                     blocks.end());
+        if (blocks.isEmpty()) _referenceBlocks.erase(it);
+    }
+
+    for (const auto &reference : newReferences) {
+        QVector<QTextBlock> &blocks = _referenceBlocks[reference.first];
+        if (!blocks.contains(block)) blocks.append(block);
+    }
+}
+
+/**
+ * Returns the url of the first reference definition like "[1]: http://domain"
+ * of a reference id in the document, without searching the document
+ *
+ * The definitions are indexed while the blocks are highlighted.
+ *
+ * @param referenceId
+ * @return the url or a null string if there is no definition
+ */
+QString MarkdownHighlighter::referenceUrl(const QString &referenceId) const {
+    if (_referenceDocument.isNull() || _referenceDocument != document()) {
+        return QString();
+    }
+
+    const auto it = _referenceBlocks.constFind(referenceId);
+    if (it == _referenceBlocks.constEnd()) return QString();
+
+    QString url;
+    int urlPosition = -1;
+
+    for (const QTextBlock &block : it.value()) {
+        // deleted blocks might have been reused for other blocks
+        const BlockData *data = block.isValid() ? blockData(block) : nullptr;
+        if (!data) continue;
+        if (urlPosition != -1 && block.position() > urlPosition) continue;
+
+        for (const auto &reference : data->references) {
+            if (reference.first == referenceId) {
+                url = reference.second;
+                urlPosition = block.position();
+                break;
+            }
+        }
+    }
+
+    return url;
+}
+
+/**
+ * Returns the data of a block or nullptr if it has none
+ *
+ * @param blockNumber
+ * @return
+ */
+const MarkdownHighlighter::BlockData *MarkdownHighlighter::blockData(
+    int blockNumber) const {
+    const QTextDocument *doc = document();
+    if (!doc) return nullptr;
+
+    return blockData(doc->findBlockByNumber(blockNumber));
+}
+
+/**
+ * Returns the data of a block or nullptr if it has none
+ *
+ * @param block
+ * @return
+ */
+const MarkdownHighlighter::BlockData *MarkdownHighlighter::blockData(
+    const QTextBlock &block) {
+    // the user data of the blocks is only set by the highlighter
+    return static_cast<const BlockData *>(block.userData());
+}
+
+/**
+ * Returns true if the block is the opening or closing fence of a code block,
+ * without needing the text of the block
+ *
+ * @param block
+ * @return
+ */
+bool MarkdownHighlighter::isCodeBlockFence(const QTextBlock &block) const {
+    const BlockData *data = blockData(block);
+    return data && data->codeBlockFence;
+}
+
+/**
+ * Returns true if the text of the block is right-to-left, without needing
+ * the text of the block
+ *
+ * @param block
+ * @return
+ */
+bool MarkdownHighlighter::isRightToLeft(const QTextBlock &block) const {
+    const BlockData *data = blockData(block);
+    return data && data->rightToLeft;
+}
+
 QPair<int, int> MarkdownHighlighter::findPositionInRanges(
     MarkdownHighlighter::RangeType type, int blockNum, int pos) const {
-    const QVector<InlineRange> rangeList = _ranges.value(blockNum);
-    auto it = std::find_if(
-        rangeList.cbegin(), rangeList.cend(),
-        [pos, type](const InlineRange &range) {
-            if ((pos == range.begin || pos == range.end) && range.type == type)
-                return true;
-            return false;
-        });
-    if (it == rangeList.cend()) return {-1, -1};
-    return {it->begin, it->end};
+    const BlockData *data = blockData(blockNum);
+    InlineRange range;
+    if (!data || !data->find(type, pos, true, &range)) return {-1, -1};
+    return {range.begin, range.end};
 }
 
 bool MarkdownHighlighter::isPosInACodeSpan(int blockNumber,
                                            int position) const {
-    const QVector<InlineRange> rangeList = _ranges.value(blockNumber);
-    return std::find_if(rangeList.cbegin(), rangeList.cend(),
-                        [position](const InlineRange &range) {
-                            if (position > range.begin &&
-                                position < range.end &&
-                                range.type == RangeType::CodeSpan)
-                                return true;
-                            return false;
-                        }) != rangeList.cend();
+    const BlockData *data = blockData(blockNumber);
+    return data && data->find(RangeType::CodeSpan, position, false);
 }
 
 bool MarkdownHighlighter::isPosInALink(int blockNumber, int position) const {
-    const QVector<InlineRange> rangeList = _ranges.value(blockNumber);
-    return std::find_if(rangeList.cbegin(), rangeList.cend(),
-                        [position](const InlineRange &range) {
-                            return position > range.begin &&
-                                   position < range.end &&
-                                   range.type == RangeType::Link;
-                        }) != rangeList.cend();
+    const BlockData *data = blockData(blockNumber);
+    return data && data->find(RangeType::Link, position, false);
 }
 
 QPair<int, int> MarkdownHighlighter::getSpanRange(
     MarkdownHighlighter::RangeType rangeType, int blockNumber,
     int position) const {
-    const QVector<InlineRange> rangeList = _ranges.value(blockNumber);
-    const auto it =
-        std::find_if(rangeList.cbegin(), rangeList.cend(),
-                     [position, rangeType](const InlineRange &range) {
-                         if (position > range.begin && position < range.end &&
-                             range.type == rangeType)
-                             return true;
-                         return false;
-                     });
+    const BlockData *data = blockData(blockNumber);
+    InlineRange range;
 
-    if (it == rangeList.cend()) {
+    if (!data || !data->find(rangeType, position, false, &range)) {
         return QPair<int, int>(-1, -1);
     } else {
-        return QPair<int, int>(it->begin, it->end);
+        return QPair<int, int>(range.begin, range.end);
     }
 }
 
@@ -2780,17 +5244,34 @@ QPair<int, int> MarkdownHighlighter::getSpanRange(
  */
 void MarkdownHighlighter::highlightEmAndStrong(const QString &text,
                                                const int pos) {
-    // 1. collect all em/strong delimiters
-    QVector<Delimiter> delims;
-    for (int i = pos; i < text.length(); ++i) {
-        if (text.at(i) != QLatin1Char('_') && text.at(i) != QLatin1Char('*'))
-            continue;
+    MH_MEASURE_PHASE(EmAndStrongPhase, text);
 
-        bool isInCodeSpan = isPosInACodeSpan(currentBlock().blockNumber(), i);
-        if (isInCodeSpan) continue;
+    QVector<InlineRange> &ranges = currentBlockRanges();
 
-        i = collectEmDelims(text, i, delims);
-        --i;
+    // the code spans were collected from left to right and don't overlap, so
+    // they are sorted
+    QVector<InlineRange> codeSpans;
+    for (const InlineRange &range : ranges) {
+        if (range.type == RangeType::CodeSpan) codeSpans.append(range);
+    }
+
+    auto isPosInCodeSpan = [&codeSpans](int position) {
+        const auto it = std::lower_bound(
+            codeSpans.cbegin(), codeSpans.cend(), position,
+            [](const InlineRange &range, int pos) {
+                return range.begin < pos;
+            });
+        return it != codeSpans.cbegin() && position < (it - 1)->end;
+    };
+
+    // 1. collect all em/strong delimiters, their positions were collected
+    // by classifyInlineCharacters()
+    QVector<Delimiter> delims;
+    int next = pos;
+    for (const int i : _emphasisPositions) {
+        if (i < next || isPosInCodeSpan(i)) continue;
+
+        next = collectEmDelims(text, i, delims);
     }
 
     // 2. Balance pairs
@@ -2823,43 +5304,19 @@ void MarkdownHighlighter::highlightEmAndStrong(const QString &text,
             int k = startDelim.pos;
             while (text.at(k) == startDelim.marker)
                 ++k;    // look for first letter after the delim chain
-            // per character highlighting
+            // highlighting of the runs of characters with the same format
             const int boldLen = endDelim.pos - startDelim.pos;
             const bool underline = _highlightingOptions.testFlag(Underline) &&
                                    startDelim.marker == QLatin1Char('_');
-            while (k != (startDelim.pos + boldLen)) {
-                QTextCharFormat fmt = QSyntaxHighlighter::format(k);
-#if QT_VERSION < QT_VERSION_CHECK(5, 13, 0)
-                fmt.setFontFamily(_formats[Bold].fontFamily());
-#else
-                const QStringList fontFamilies =
-                    _formats[Bold].fontFamilies().toStringList();
-                if (!fontFamilies.isEmpty()) fmt.setFontFamilies(fontFamilies);
-#endif
-
-                if (_formats[state].fontPointSize() > 0)
-                    fmt.setFontPointSize(_formats[state].fontPointSize());
-
-                // if we are in plain text, use the format's specified color
-                if (fmt.foreground() == QTextCharFormat().foreground())
-                    fmt.setForeground(_formats[Bold].foreground());
-                if (underline) {
-                    fmt.setForeground(_formats[StUnderline].foreground());
-                    fmt.setFont(_formats[StUnderline].font());
-                    fmt.setFontUnderline(_formats[StUnderline].fontUnderline());
-                } else if (_formats[Bold].font().bold())
-                    fmt.setFontWeight(QFont::Bold);
-                setFormat(k, 1, fmt);
-                ++k;
-            }
+            setEmphasisFormat(k, startDelim.pos + boldLen, state, true,
+                              underline);
             masked.append({startDelim.pos - 1, 2});
             masked.append({endDelim.pos, 2});
 
-            int block = currentBlock().blockNumber();
-            _ranges[block].append(InlineRange(startDelim.pos, endDelim.pos + 1,
-                                              RangeType::Emphasis));
-            _ranges[block].append(InlineRange(startDelim.pos - 1, endDelim.pos,
-                                              RangeType::Emphasis));
+            ranges.append(InlineRange(startDelim.pos, endDelim.pos + 1,
+                                      RangeType::Emphasis));
+            ranges.append(InlineRange(startDelim.pos - 1, endDelim.pos,
+                                      RangeType::Emphasis));
             --i;
         } else {
             //            qDebug () << "Em: " << startDelim.pos << endDelim.pos;
@@ -2870,52 +5327,135 @@ void MarkdownHighlighter::highlightEmAndStrong(const QString &text,
             const bool underline = _highlightingOptions.testFlag(Underline) &&
                                    startDelim.marker == QLatin1Char('_');
             const int itLen = endDelim.pos - startDelim.pos;
-            while (k != (startDelim.pos + itLen)) {
-                QTextCharFormat fmt = QSyntaxHighlighter::format(k);
-
-#if QT_VERSION < QT_VERSION_CHECK(5, 13, 0)
-                fmt.setFontFamily(_formats[Italic].fontFamily());
-#else
-                const QStringList fontFamilies =
-                    _formats[Italic].fontFamilies().toStringList();
-                if (!fontFamilies.isEmpty()) fmt.setFontFamilies(fontFamilies);
-#endif
-
-                if (_formats[state].fontPointSize() > 0)
-                    fmt.setFontPointSize(_formats[state].fontPointSize());
-
-                if (fmt.foreground() == QTextCharFormat().foreground())
-                    fmt.setForeground(_formats[Italic].foreground());
-
-                if (underline)
-                    fmt.setFontUnderline(_formats[StUnderline].fontUnderline());
-                else
-                    fmt.setFontItalic(_formats[Italic].fontItalic());
-                setFormat(k, 1, fmt);
-                ++k;
-            }
+            setEmphasisFormat(k, startDelim.pos + itLen, state, false,
+                              underline);
             masked.append({startDelim.pos, 1});
             masked.append({endDelim.pos, 1});
 
-            int block = currentBlock().blockNumber();
-            _ranges[block].append(
+            ranges.append(
                 InlineRange(startDelim.pos, endDelim.pos, RangeType::Emphasis));
         }
     }
 
     // 4. Apply masked syntax
-    for (int i = 0; i < masked.length(); ++i) {
-        QTextCharFormat maskedFmt = _formats[MaskedSyntax];
-        auto state = static_cast<HighlighterState>(currentBlockState());
-        if (_formats[state].fontPointSize() > 0)
-            maskedFmt.setFontPointSize(_formats[state].fontPointSize());
-        setFormat(masked.at(i).first, masked.at(i).second, maskedFmt);
+    if (masked.isEmpty()) return;
+
+    QTextCharFormat maskedFmt = textFormat(MaskedSyntax);
+    const auto state = static_cast<HighlighterState>(currentBlockState());
+    if (textFormat(state).fontPointSize() > 0)
+        maskedFmt.setFontPointSize(textFormat(state).fontPointSize());
+
+    // adjacent and overlapping delimiters (like in "***") are masked in
+    // one go
+    std::sort(masked.begin(), masked.end());
+    int maskedStart = masked.at(0).first;
+    int maskedEnd = maskedStart + masked.at(0).second;
+    for (int i = 1; i < masked.length(); ++i) {
+        const int start = masked.at(i).first;
+        if (start > maskedEnd) {
+            setFormat(maskedStart, maskedEnd - maskedStart, maskedFmt);
+            maskedStart = start;
+        }
+        maskedEnd = qMax(maskedEnd, start + masked.at(i).second);
+    }
+    setFormat(maskedStart, maskedEnd - maskedStart, maskedFmt);
+}
+
+/**
+ * @brief applies the bold or italic format to the characters from begin to
+ * end, with one setFormat() call for every run of characters that had the
+ * same format
+ */
+void MarkdownHighlighter::setEmphasisFormat(int begin, int end,
+                                            HighlighterState state,
+                                            bool strong, bool underline) {
+    int k = begin;
+
+    while (k < end) {
+        const QTextCharFormat base = format(k);
+        int runEnd = k + 1;
+        while (runEnd < end && format(runEnd) == base) ++runEnd;
+
+        setFormat(k, runEnd - k,
+                  emphasisFormat(base, state, strong, underline));
+        k = runEnd;
+    }
+}
+
+/**
+ * @brief returns the bold or italic version of a format, the formats are only
+ * merged once per theme and then reused
+ */
+const QTextCharFormat &MarkdownHighlighter::emphasisFormat(
+    const QTextCharFormat &base, HighlighterState state, bool strong,
+    bool underline) {
+    if (_emphasisFormatsTheme != _theme) {
+        _emphasisFormatsTheme = _theme;
+        _emphasisFormats.clear();
+    }
+
+    for (const EmphasisFormat &cached : _emphasisFormats) {
+        if (cached.state == state && cached.strong == strong &&
+            cached.underline == underline && cached.base == base) {
+            return cached.format;
+        }
+    }
+
+    // there are only a few different formats per note, but don't let the
+    // cache grow without limits
+    if (_emphasisFormats.size() >= maxEmphasisFormats) {
+        _emphasisFormats.clear();
+    }
+
+    const QTextCharFormat &emphasis = textFormat(strong ? Bold : Italic);
+    QTextCharFormat fmt = base;
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 13, 0)
+    fmt.setFontFamily(emphasis.fontFamily());
+#else
+    const QStringList fontFamilies = emphasis.fontFamilies().toStringList();
+    if (!fontFamilies.isEmpty()) fmt.setFontFamilies(fontFamilies);
+#endif
+
+    if (textFormat(state).fontPointSize() > 0)
+        fmt.setFontPointSize(textFormat(state).fontPointSize());
+
+    // if we are in plain text, use the format's specified color
+    if (fmt.foreground() == QTextCharFormat().foreground())
+        fmt.setForeground(emphasis.foreground());
+
+    if (strong) {
+        if (underline) {
+            fmt.setForeground(textFormat(StUnderline).foreground());
+            fmt.setFont(textFormat(StUnderline).font());
+            fmt.setFontUnderline(textFormat(StUnderline).fontUnderline());
+        } else if (emphasis.font().bold())
+            fmt.setFontWeight(QFont::Bold);
+    } else {
+        if (underline)
+            fmt.setFontUnderline(textFormat(StUnderline).fontUnderline());
+        else
+            fmt.setFontItalic(emphasis.fontItalic());
     }
+
+    EmphasisFormat cached;
+    cached.base = base;
+    cached.state = state;
+    cached.strong = strong;
+    cached.underline = underline;
+    cached.format = fmt;
+    _emphasisFormats.append(cached);
+    return _emphasisFormats.last().format;
 }
 
 void MarkdownHighlighter::setHighlightingOptions(
     const HighlightingOptions options) {
+    // the cached documents were highlighted with the old options
+    if (options != _highlightingOptions) _stateCache.clear();
+
     _highlightingOptions = options;
+    _themeGeneration = -1;
+    updateTheme();
 }
 
 #undef MH_SUBSTR
@@ -26,9 +26,15 @@
 
 #pragma once
 
+#include <QCache>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QPointer>
 #include <QRegularExpression>
+#include <QSharedPointer>
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
+#include <QTextCursor>
 
 #ifdef QT_QUICK_LIB
 #include <QQuickTextDocument>
@@ -39,9 +45,18 @@ class QTextDocument;
 
 QT_END_NAMESPACE
 
+class LanguageData;
+
 class MarkdownHighlighter : public QSyntaxHighlighter {
     Q_OBJECT
 
+    Q_PROPERTY(bool asyncHighlighting READ asyncHighlightingEnabled WRITE
+                   setAsyncHighlightingEnabled)
+    Q_PROPERTY(bool lazyHighlighting READ lazyHighlightingEnabled WRITE
+                   setLazyHighlightingEnabled)
+    Q_PROPERTY(bool busy READ isBusy NOTIFY busyChanged)
+    Q_PROPERTY(qreal progress READ progress NOTIFY progressChanged)
+
 #ifdef QT_QUICK_LIB
     Q_PROPERTY(QQuickTextDocument *textDocument READ textDocument WRITE
                    setTextDocument NOTIFY textDocumentChanged)
@@ -72,9 +87,11 @@ class MarkdownHighlighter : public QSyntaxHighlighter {
     MarkdownHighlighter(
         QTextDocument *parent = nullptr,
         HighlightingOptions highlightingOptions = HighlightingOption::None);
+    ~MarkdownHighlighter() override;
 
     static inline QColor codeBlockBackgroundColor() {
-        const QBrush brush = _formats[CodeBlock].background();
+        const QBrush brush =
+            defaultTheme()->formats.value(CodeBlock).background();
 
         if (!brush.isOpaque()) {
             return QColor(Qt::transparent);
@@ -113,6 +130,9 @@ class MarkdownHighlighter : public QSyntaxHighlighter {
     bool isPosInALink(int blockNumber, int position) const;
     QPair<int, int> getSpanRange(RangeType rangeType, int blockNumber,
                                  int position) const;
+    bool isCodeBlockFence(const QTextBlock &block) const;
+    bool isRightToLeft(const QTextBlock &block) const;
+    QString referenceUrl(const QString &referenceId) const;
 
     // we used some predefined numbers here to be compatible with
     // the peg-Markdown parser
@@ -220,31 +240,154 @@ class MarkdownHighlighter : public QSyntaxHighlighter {
     };
     Q_ENUM(HighlighterState)
 
+    struct HighlightingRule {
+        explicit HighlightingRule(const HighlighterState state_)
+            : state(state_) {}
+        HighlightingRule() = default;
+
+        QRegularExpression pattern;
+        QString shouldContain;
+        HighlighterState state = NoState;
+        uint8_t capturingGroup = 0;
+        uint8_t maskedGroup = 0;
+    };
+
+    /**
+     * Text formats and highlighting rules that are compiled once and then
+     * shared (also with the asynchronous highlighting) by all highlighters
+     * using them, so they must not be modified anymore after creation
+     */
+    struct Theme {
+        QHash<HighlighterState, QTextCharFormat> formats;
+        // the formats by their formatIndex(), for fast lookups
+        QVector<QTextCharFormat> formatTable;
+        QVector<HighlightingRule> highlightingRules;
+        QHash<QString, HighlighterState> langStringToEnum;
+    };
+    using ThemePointer = QSharedPointer<const Theme>;
+
+    static ThemePointer createTheme(
+        QHash<HighlighterState, QTextCharFormat> formats,
+        HighlightingOptions highlightingOptions = HighlightingOption::None);
+    static ThemePointer defaultTheme(
+        HighlightingOptions highlightingOptions = HighlightingOption::None);
+    using LanguageLoader = const LanguageData &(*)();
+    static HighlighterState registerLanguage(const QStringList &names,
+                                             LanguageLoader loader,
+                                             QChar lineComment = QChar());
+    void setTheme(ThemePointer theme);
+    inline ThemePointer theme() const { return _theme; }
     static void setTextFormats(
         QHash<HighlighterState, QTextCharFormat> formats);
     static void setTextFormat(HighlighterState state, QTextCharFormat format);
     void clearDirtyBlocks();
     void setHighlightingOptions(const HighlightingOptions options);
     void initHighlightingRules();
+    void setAsyncHighlightingEnabled(bool enabled);
+    inline bool asyncHighlightingEnabled() const {
+        return _asyncHighlightingEnabled;
+    }
+    void setLazyHighlightingEnabled(bool enabled);
+    inline bool lazyHighlightingEnabled() const {
+        return _lazyHighlightingEnabled;
+    }
+    Q_INVOKABLE void setVisibleBlockRange(int firstBlockNumber,
+                                          int lastBlockNumber);
+    Q_INVOKABLE void setVisiblePositionRange(int firstPosition,
+                                             int lastPosition);
+    inline bool isBusy() const { return _busy; }
+    inline qreal progress() const { return _progress; }
+    void deferNextBurst();
+    void setStateCacheBudget(qint64 bytes);
+    bool cacheDocumentState();
+    void cacheDocumentStates(const QStringList &texts);
+    void rehighlightInParallel();
+    bool restoreDocumentState(const QString &text);
+    QByteArray saveDocumentState() const;
+    bool restoreDocumentState(const QByteArray &state, const QString &text);
+
+    /**
+     * Phases of the highlighting that are measured by the instrumentation,
+     * the InlineRulesPhase includes the EmAndStrongPhase
+     */
+    enum HighlightingPhase {
+        AdditionalRulesPhase,
+        HeadlinePhase,
+        ListsPhase,
+        InlineRulesPhase,
+        EmAndStrongPhase,
+        SyntaxPhase,
+        HighlightingPhaseCount
+    };
+
+    struct PhaseStatistics {
+        qint64 nsecs = 0;
+        qint64 calls = 0;
+        qint64 characters = 0;
+    };
+
+    struct BlockStatistics {
+        int blockNumber = -1;
+        int length = 0;
+        qint64 nsecs = 0;
+    };
+
+    struct Statistics {
+        PhaseStatistics phases[HighlightingPhaseCount];
+        // the SyntaxPhase by the code block state of the language
+        QHash<HighlighterState, PhaseStatistics> languages;
+        // the slowest highlighted blocks, the slowest first
+        QVector<BlockStatistics> slowestBlocks;
+        // all highlighted blocks
+        PhaseStatistics blocks;
+    };
+
+    /**
+     * Memory used by the highlighting of a document, in bytes
+     */
+    struct MemoryUsage {
+        // inline ranges, references and properties of the blocks
+        qint64 blockData = 0;
+        // format ranges in the layouts of the blocks
+        qint64 formatRanges = 0;
+        // asynchronous or restored results that weren't applied yet
+        qint64 pendingResults = 0;
+        // highlighting of the documents in the state cache
+        qint64 stateCache = 0;
+
+        inline qint64 total() const {
+            return blockData + formatRanges + pendingResults + stateCache;
+        }
+    };
+
+    MemoryUsage memoryUsage() const;
+
+    static bool instrumentationEnabled();
+    inline const Statistics &statistics() const { return _statistics; }
+    void resetStatistics();
+
+    struct FormatRun {
+        int start;
+        int length;
+        QTextCharFormat format;
+    };
+
+    class Lexer;
+
+    static QVector<QVector<FormatRun>> highlightLines(
+        const QStringList &lines,
+        HighlightingOptions highlightingOptions = HighlightingOption::None,
+        ThemePointer theme = ThemePointer());
 
    Q_SIGNALS:
     void highlightingFinished();
+    void busyChanged();
+    void progressChanged();
 
    protected Q_SLOTS:
     void timerTick();
 
    protected:
-    struct HighlightingRule {
-        explicit HighlightingRule(const HighlighterState state_)
-            : state(state_) {}
-        HighlightingRule() = default;
-
-        QRegularExpression pattern;
-        QString shouldContain;
-        HighlighterState state = NoState;
-        uint8_t capturingGroup = 0;
-        uint8_t maskedGroup = 0;
-    };
     struct InlineRange {
         int begin;
         int end;
@@ -254,11 +397,148 @@ class MarkdownHighlighter : public QSyntaxHighlighter {
             : begin{begin_}, end{end_}, type{type_} {}
     };
 
+    static constexpr int NoPreviousBlockState = NoState - 1;
+
+    /**
+     * Input and output of highlighting a single block without a
+     * QTextDocument, used by the asynchronous highlighting
+     */
+    struct BlockContext {
+        // input
+        QString previousText;
+        QString nextText;
+        int previousState = NoState;
+        bool isFirstBlock = false;
+
+        // output
+        int state = NoState;
+        // user state the previous block needs to be re-highlighted with,
+        // NoPreviousBlockState if it doesn't need to be touched
+        int previousBlockState = NoPreviousBlockState;
+        QVector<QTextCharFormat> formats;
+        QVector<InlineRange> ranges;
+    };
+
+    struct EmphasisFormat {
+        QTextCharFormat base;
+        HighlighterState state;
+        bool strong;
+        bool underline;
+        QTextCharFormat format;
+    };
+
+    /**
+     * Highlighting of a block that was computed in a worker thread and
+     * still needs to be applied to the document
+     */
+    struct BlockResult {
+        int blockNumber = 0;
+        QString text;
+        int previousState = NoState;
+        int state = NoState;
+        int previousBlockState = NoPreviousBlockState;
+        QVector<FormatRun> runs;
+        QVector<InlineRange> ranges;
+    };
+
+    static void formatRuns(const QVector<QTextCharFormat> &formats,
+                           QVector<FormatRun> &runs);
+
+    struct AsyncJob;
+    struct ChunkWorker;
+    struct BlockData;
+    struct LexerTag {};
+
+    MarkdownHighlighter(LexerTag, HighlightingOptions highlightingOptions);
+
     void highlightBlock(const QString &text) override;
 
-    static void initTextFormats(int defaultFontSize = 12);
+    void customEvent(QEvent *event) override;
+
+    /**
+     * Maps the states to a dense index of the format table of the themes,
+     * states without a format get the last (always empty) format
+     */
+    static constexpr inline int formatIndex(const int state) {
+        return state >= NoState && state < CodeCpp ? state - NoState
+               : state >= CodeKeyWord && state <= CodeBuiltIn
+                   ? CodeCpp + 1 + state - CodeKeyWord
+               : state >= CodeCpp && state < CodeCpp + languageStateCount
+                   ? CodeCpp + 8 + state - CodeCpp
+               : state >= CodeCpp + tildeOffset &&
+                       state < CodeCpp + tildeOffset + languageStateCount
+                   ? CodeCpp + 8 + languageStateCount + state - CodeCpp -
+                         tildeOffset
+                   : formatCount - 1;
+    }
+
+    /**
+     * Maps the code block states to the state of their language, without
+     * the tilde offset and the comment state of the language
+     */
+    static constexpr inline HighlighterState languageState(const int state) {
+        return static_cast<HighlighterState>(
+            state < CodeCpp ? state
+            : state >= CodeCpp + tildeOffset
+                ? CodeCpp + ((state - tildeOffset - CodeCpp) & ~1)
+                : CodeCpp + ((state - CodeCpp) & ~1));
+    }
+
+    inline const QTextCharFormat &textFormat(HighlighterState state) const {
+        return _theme->formatTable.at(formatIndex(state));
+    }
+
+    void updateTheme();
+
+    /******************************
+     *  BLOCK ACCESS FUNCTIONS
+     *
+     *  These hide the QSyntaxHighlighter functions, so the highlighting
+     *  functions also work on a BlockContext
+     ******************************/
+
+    void setFormat(int start, int count, const QTextCharFormat &format);
+    QTextCharFormat format(int position) const;
+    int currentBlockState() const;
+    void setCurrentBlockState(int newState);
+    int previousBlockState() const;
+    QString previousBlockText() const;
+    QString nextBlockText() const;
+    bool isFirstBlock() const;
+    QVector<InlineRange> &currentBlockRanges();
+    void setCurrentBlockData(const QString &text,
+                             const QVector<InlineRange> &ranges);
+    const BlockData *blockData(int blockNumber) const;
+    static const BlockData *blockData(const QTextBlock &block);
+    void updateReferenceIndex(
+        const QTextBlock &block,
+        const QVector<QPair<QString, QString>> &oldReferences,
+        const QVector<QPair<QString, QString>> &newReferences);
+    void markPreviousBlockDirty(int state);
+    void updateSetextHeadingBlocks(int blockState);
+    void addBlockStatistics(int length, qint64 nsecs);
+    static quint64 stateCacheKey(const QString &text);
+    static int stateCacheCost(const QVector<BlockResult> &results);
+    static qint64 blockResultSize(const BlockResult &result);
+
+    // a language registered with registerLanguage()
+    struct RegisteredLanguage {
+        LanguageLoader loader = nullptr;
+        QChar lineComment;
+    };
+    static RegisteredLanguage *registeredLanguages();
+    static const RegisteredLanguage *registeredLanguage(int state);
+    static HighlighterState registeredLanguageState(const QString &name);
+    bool documentState(QVector<BlockResult> &results) const;
+    QByteArray stateFingerprint() const;
+
+    static QHash<HighlighterState, QTextCharFormat> createTextFormats(
+        int defaultFontSize = 12);
+
+    static QVector<HighlightingRule> createHighlightingRules(
+        HighlightingOptions highlightingOptions);
 
-    static void initCodeLangs();
+    static QHash<QString, HighlighterState> createCodeLangs();
 
     void highlightMarkdown(const QString &text);
 
@@ -277,6 +557,9 @@ class MarkdownHighlighter : public QSyntaxHighlighter {
     void highlightAdditionalRules(const QVector<HighlightingRule> &rules,
                                   const QString &text);
 
+    static quint64 findRuleLiterals(const QVector<HighlightingRule> &rules,
+                                    const QString &text);
+
     void highlightFrontmatterBlock(const QString &text);
 
     void highlightCommentBlock(const QString &text);
@@ -298,10 +581,23 @@ class MarkdownHighlighter : public QSyntaxHighlighter {
 
     void highlightEmAndStrong(const QString &text, const int pos);
 
+    void setEmphasisFormat(int begin, int end, HighlighterState state,
+                           bool strong, bool underline);
+
+    const QTextCharFormat &emphasisFormat(const QTextCharFormat &base,
+                                          HighlighterState state, bool strong,
+                                          bool underline);
+
     Q_REQUIRED_RESULT int highlightInlineComment(const QString &text, int pos);
 
     int highlightLinkOrImage(const QString &text, int startIndex);
 
+    static void classifyInlineCharacters(const QString &text,
+                                         QVector<int> &inlinePositions,
+                                         QVector<int> &emphasisPositions);
+
+    static bool areLinksAllowed(const QString &text);
+
     void setHeadingStyles(MarkdownHighlighter::HighlighterState rule,
                           const QRegularExpressionMatch &match,
                           const int capturedGroup);
@@ -345,16 +641,140 @@ class MarkdownHighlighter : public QSyntaxHighlighter {
 
     void reHighlightDirtyBlocks();
 
-    bool _highlightingFinished;
+    void scheduleTimerTick(int msec);
+
+    void markHighlightingFinished();
+
+    /******************************
+     *  DEFERRED HIGHLIGHTING
+     ******************************/
+
+    void highlightBlockInContext(const QString &text, BlockContext &context);
+    bool highlightBlockDeferred(const QString &text, int blockState);
+    void keepCurrentBlockHighlighting(int blockState);
+    void deferBlocks(const QTextBlock &first, const QTextBlock &last);
+    void clearDeferredBlocks();
+    void advanceDeferredBlocks();
+    bool isBlockVisible(int blockNumber) const;
+    void resetBurst();
+    void scheduleDeferredHighlighting();
+    void processDeferredBlocks();
+    void highlightDeferredBlocks(bool timeSliced);
+    void highlightVisibleBlocks();
+
+    /******************************
+     *  ASYNCHRONOUS HIGHLIGHTING
+     ******************************/
+
+    bool applyAsyncResult(const QString &text);
+    void startAsyncHighlighting();
+    int stopAsyncHighlighting();
+    void takeAsyncResults();
+    void applyAsyncResults();
+    int pendingBlockNumber() const;
+    void scheduleProgressUpdate();
+    void updateProgress();
+    static void lexTexts(const QVector<QStringList> &texts,
+                         HighlightingOptions highlightingOptions,
+                         const ThemePointer &theme,
+                         QVector<QVector<BlockResult>> &results);
+    void lexLines(const QStringList &lines, int begin, int end,
+                  int previousState, BlockResult *results, bool converge);
+
+    bool _highlightingFinished = false;
     HighlightingOptions _highlightingOptions;
-    QTimer *_timer;
+    QTimer *_timer = nullptr;
+    // dirty blocks, they are sorted by their position when re-highlighted
     QVector<QTextBlock> _dirtyTextBlocks;
     QVector<QPair<int, int>> _linkRanges;
 
-    QHash<int, QVector<InlineRange>> _ranges;
-
-    static QVector<HighlightingRule> _highlightingRules;
-    static QHash<HighlighterState, QTextCharFormat> _formats;
-    static QHash<QString, HighlighterState> _langStringToEnum;
+    // inline ranges of the block that is currently highlighted
+    QVector<InlineRange> _blockRanges;
+    // positions of the characters the inline highlighting reacts to
+    QVector<int> _inlinePositions;
+    QVector<int> _emphasisPositions;
+
+    // blocks with reference definitions by their reference ids
+    QHash<QString, QVector<QTextBlock>> _referenceBlocks;
+    QPointer<QTextDocument> _referenceDocument;
+
+    BlockContext *_context = nullptr;
+
+    // only recorded if the library is built with instrumentation
+    Statistics _statistics;
+
+    QTextCursor _deferredFrom;
+    QTextCursor _deferredTo;
+    QElapsedTimer _deferredTimer;
+    int _burstCount = 0;
+    int _visibleFirst = -1;
+    int _visibleLast = -1;
+    bool _highlightingDeferredBlocks = false;
+    bool _deferredTimeSliced = false;
+    bool _deferredScheduled = false;
+    bool _visibleScheduled = false;
+    bool _lazyHighlightingEnabled = false;
+    // the next burst is deferred even if no deferred mode is enabled
+    bool _deferNextBurst = false;
+    // the deferred blocks of such a burst are highlighted lazily
+    bool _deferredBurst = false;
+
+    // highlighting of whole documents by their stateCacheKey(), with their
+    // size in KiB as cost, it is cleared when the theme or the options change
+    QCache<quint64, QVector<BlockResult>> _stateCache{0};
+
+    AsyncJob *_asyncJob = nullptr;
+    QMap<int, BlockResult> _asyncResults;
+    bool _asyncApplyScheduled = false;
+    bool _asyncHighlightingEnabled = false;
+
+    // part of the document that is highlighted, for busy and progress
+    qreal _progress = 1.0;
+    bool _busy = false;
+    bool _progressScheduled = false;
+
+    ThemePointer _theme;
+    // bold and italic formats merged with the formats they are applied to
+    QVector<EmphasisFormat> _emphasisFormats;
+    ThemePointer _emphasisFormatsTheme;
+    int _themeGeneration = -1;
+    bool _customTheme = false;
     static constexpr int tildeOffset = 300;
+    // number of states reserved for the languages and their comments
+    static constexpr int languageStateCount = 100;
+    // the states after the built-in languages, for registerLanguage()
+    static constexpr int firstRegisteredLanguageState = CodeTOMLString + 1;
+    static constexpr int registeredLanguageCount =
+        (CodeCpp + languageStateCount - firstRegisteredLanguageState) / 2;
+    // markdown states from NoState, code token states, language states,
+    // tilde language states and the empty format
+    static constexpr int formatCount =
+        CodeCpp + 8 + 2 * languageStateCount + 1;
+};
+
+/**
+ * Highlights lines without a QTextDocument (and without a GUI), like for
+ * indexing notes or preparing previews in batch jobs
+ *
+ * The lines of a text have to be highlighted in order, because every line
+ * continues with the state of the previous line. A lexer can be used in any
+ * thread, but only in one thread at a time.
+ */
+class MarkdownHighlighter::Lexer {
+   public:
+    explicit Lexer(
+        HighlightingOptions highlightingOptions = HighlightingOption::None,
+        ThemePointer theme = ThemePointer());
+    Lexer(const Lexer &) = delete;
+    Lexer &operator=(const Lexer &) = delete;
+
+    void reset();
+    int highlightLine(const QString &line, const QString &nextLine,
+                      QVector<FormatRun> &runs);
+    inline int state() const { return _context.previousState; }
+
+   private:
+    MarkdownHighlighter _lexer;
+    BlockContext _context;
+    bool _firstLine = true;
 };
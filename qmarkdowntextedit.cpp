@@ -28,11 +28,13 @@
 #include <QDebug>
 #include <QDesktopServices>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QGuiApplication>
 #include <QKeyEvent>
 #include <QLayout>
 #include <QPainter>
-#include <QPainterPath>
+#include <QPointer>
 #include <QRegularExpression>
 #include <QRegularExpressionMatch>
 #include <QRegularExpressionMatchIterator>
@@ -40,6 +42,8 @@
 #include <QTextBlock>
 #include <QTimer>
 #include <QWheelEvent>
+#include <algorithm>
+#include <limits>
 #include <utility>
 
 #include "linenumberarea.h"
@@ -48,6 +52,15 @@
 static const QByteArray _openingCharacters = QByteArrayLiteral("([{<*\"'_~");
 static const QByteArray _closingCharacters = QByteArrayLiteral(")]}>*\"'_~");
 
+// the size of the largest UTF-8 data that is loaded, a QString can't hold
+// more UTF-16 characters (and UTF-8 never needs fewer bytes than those)
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+static const qint64 maxUtf8DataSize = std::numeric_limits<int>::max() / 2 - 16;
+#else
+static const qint64 maxUtf8DataSize =
+    std::numeric_limits<qsizetype>::max() / 2 - 16;
+#endif
+
 QMarkdownTextEdit::QMarkdownTextEdit(QWidget *parent, bool initHighlighter)
     : QPlainTextEdit(parent) {
     installEventFilter(this);
@@ -94,10 +107,10 @@ QMarkdownTextEdit::QMarkdownTextEdit(QWidget *parent, bool initHighlighter)
             &QMarkdownTextEdit::adjustRightMargin);
     connect(this, &QPlainTextEdit::cursorPositionChanged, this,
             &QMarkdownTextEdit::centerTheCursor);
-    connect(verticalScrollBar(), &QScrollBar::valueChanged, this,
-            [this](int) { _lineNumArea->update(); });
+    // scrolling is handled by updateLineNumberArea(), which only paints the
+    // newly exposed rows of the line numbers
     connect(this, &QPlainTextEdit::cursorPositionChanged, this, [this]() {
-        _lineNumArea->update();
+        _lineNumArea->setCurrentBlockNumber(textCursor().blockNumber());
 
         auto oldArea = blockBoundingGeometry(_textCursor.block())
                            .translated(contentOffset());
@@ -176,6 +189,8 @@ bool QMarkdownTextEdit::highlightingEnabled() const {
  * that the search buttons don't get visually blocked by the scroll bar
  */
 void QMarkdownTextEdit::adjustRightMargin() {
+    if (_bulkLoading) return;
+
     QMargins margins = layout()->contentsMargins();
     const int rightMargin =
         document()->size().height() > viewport()->size().height() ? 24 : 0;
@@ -599,63 +614,57 @@ void QMarkdownTextEdit::moveTextUpDown(bool up) {
         return;
     }
 
-    QTextCursor cursor = textCursor();
-    QTextCursor move = cursor;
+    const QTextCursor cursor = textCursor();
+    const bool hasSelection = cursor.hasSelection();
+    const QTextBlock firstBlock =
+        document()->findBlock(cursor.selectionStart());
+    QTextBlock lastBlock = document()->findBlock(cursor.selectionEnd());
 
-    move.setVisualNavigation(false);
+    // if the selection ends at the start of a block, that block isn't moved
+    if (lastBlock != firstBlock &&
+        cursor.selectionEnd() == lastBlock.position()) {
+        lastBlock = lastBlock.previous();
+    }
 
-    move.beginEditBlock();    // open an edit block to keep undo operations sane
-    bool hasSelection = cursor.hasSelection();
+    // the block the moved blocks swap places with
+    const QTextBlock otherBlock = up ? firstBlock.previous() : lastBlock.next();
+    if (!otherBlock.isValid()) {
+        return;
+    }
 
-    if (hasSelection) {
-        // if there's a selection inside the block, we select the whole block
-        move.setPosition(cursor.selectionStart());
-        move.movePosition(QTextCursor::StartOfBlock);
-        move.setPosition(cursor.selectionEnd(), QTextCursor::KeepAnchor);
-        move.movePosition(
-            move.atBlockStart() ? QTextCursor::Left : QTextCursor::EndOfBlock,
-            QTextCursor::KeepAnchor);
+    const int linesEnd = lastBlock.position() + lastBlock.length() - 1;
+    QTextCursor move(document());
+    move.setPosition(firstBlock.position());
+    move.setPosition(linesEnd, QTextCursor::KeepAnchor);
+    const QString text = move.selectedText();
+    const QString otherText = otherBlock.text();
+
+    // replace both parts at once, so the blocks are only changed once
+    if (up) {
+        move.setPosition(otherBlock.position());
+        move.setPosition(linesEnd, QTextCursor::KeepAnchor);
     } else {
-        move.movePosition(QTextCursor::StartOfBlock);
-        move.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
-    }
-
-    // get the text of the current block
-    QString text = move.selectedText();
-
-    move.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor);
-    move.removeSelectedText();
-
-    if (up) {    // up key
-        move.movePosition(QTextCursor::PreviousBlock);
-        move.insertBlock();
-        move.movePosition(QTextCursor::Left);
-    } else {    // down key
-        move.movePosition(QTextCursor::EndOfBlock);
-        if (move.atBlockStart()) {    // empty block
-            move.movePosition(QTextCursor::NextBlock);
-            move.insertBlock();
-            move.movePosition(QTextCursor::Left);
-        } else {
-            move.insertBlock();
-        }
+        move.setPosition(firstBlock.position());
+        move.setPosition(otherBlock.position() + otherText.length(),
+                         QTextCursor::KeepAnchor);
     }
 
-    int start = move.position();
-    move.clearSelection();
-    move.insertText(text);
-    int end = move.position();
+    const int start = up ? otherBlock.position()
+                         : firstBlock.position() + otherText.length() + 1;
+
+    bulkEdit([&]() {
+        move.insertText(up ? text + QLatin1Char('\n') + otherText
+                           : otherText + QLatin1Char('\n') + text);
+    });
 
     // reselect
     if (hasSelection) {
-        move.setPosition(end);
+        move.setPosition(start + text.length());
         move.setPosition(start, QTextCursor::KeepAnchor);
     } else {
         move.setPosition(start);
     }
 
-    move.endEditBlock();
-
     setTextCursor(move);
 }
 
@@ -1083,60 +1092,66 @@ void QMarkdownTextEdit::resizeEvent(QResizeEvent *event) {
 bool QMarkdownTextEdit::increaseSelectedTextIndention(
     bool reverse, const QString &indentCharacters) {
     QTextCursor cursor = this->textCursor();
-    QString selectedText = cursor.selectedText();
 
-    if (!selectedText.isEmpty()) {
+    if (cursor.hasSelection()) {
         // Start the selection at start of the first block of the selection
-        int end = cursor.selectionEnd();
+        const int end = cursor.selectionEnd();
         cursor.setPosition(cursor.selectionStart());
         cursor.movePosition(QTextCursor::StartOfBlock, QTextCursor::MoveAnchor);
+        const int start = cursor.position();
         cursor.setPosition(end, QTextCursor::KeepAnchor);
-        this->setTextCursor(cursor);
-        selectedText = cursor.selectedText();
 
-        // we need this strange newline character we are getting in the
-        // selected text for newlines
-        const QString newLine =
-            QString::fromUtf8(QByteArray::fromHex(QByteArrayLiteral("e280a9")));
+        const int indentSize = indentCharacters == QStringLiteral("\t")
+                                   ? 4
+                                   : indentCharacters.length();
+
+        // build the new text of the selected lines in one buffer
         QString newText;
+        newText.reserve(end - start + 1);
+
+        for (QTextBlock block = document()->findBlock(start);
+             block.isValid() && block.position() <= end;
+             block = block.next()) {
+            const QString blockText = block.text();
+            const int length = std::min(static_cast<int>(blockText.length()),
+                                        end - block.position());
+            const bool firstLine = block.position() == start;
+
+            if (!firstLine) {
+                newText += QLatin1Char('\n');
+            }
 
-        if (reverse) {
-            // un-indent text
-
-            const int indentSize = indentCharacters == QStringLiteral("\t")
-                                       ? 4
-                                       : indentCharacters.length();
-
-            // remove leading \t or spaces in following lines
-            newText = selectedText.replace(
-                QRegularExpression(newLine + QStringLiteral("(\\t| {1,") +
-                                   QString::number(indentSize) +
-                                   QStringLiteral("})")),
-                QStringLiteral("\n"));
-
-            // remove leading \t or spaces in first line
-            newText.remove(QRegularExpression(QStringLiteral("^(\\t| {1,") +
-                                              QString::number(indentSize) +
-                                              QStringLiteral("})")));
-        } else {
-            // replace trailing new line to prevent an indent of the line after
-            // the selection
-            newText = selectedText.replace(
-                QRegularExpression(QRegularExpression::escape(newLine) +
-                                   QStringLiteral("$")),
-                QStringLiteral("\n"));
-
-            // indent text
-            newText.replace(newLine, QStringLiteral("\n") + indentCharacters)
-                .prepend(indentCharacters);
-
-            // remove trailing \t
-            static QRegularExpression regex1(QStringLiteral("\\t$"));
-            newText.remove(regex1);
+            if (reverse) {
+                // remove a leading \t or up to indentSize spaces
+                int indent = 0;
+                if (length > 0 && blockText.at(0) == QLatin1Char('\t')) {
+                    indent = 1;
+                } else {
+                    while (indent < length && indent < indentSize &&
+                           blockText.at(indent) == QLatin1Char(' ')) {
+                        ++indent;
+                    }
+                }
+
+                newText += blockText.mid(indent, length - indent);
+            } else {
+                // don't indent the line after the selection, if the selection
+                // ends with a new line
+                if (firstLine || block.position() < end) {
+                    newText += indentCharacters;
+                }
+
+                newText += blockText.left(length);
+            }
+        }
+
+        // remove trailing \t
+        if (!reverse && newText.endsWith(QLatin1Char('\t'))) {
+            newText.chop(1);
         }
 
         // insert the new text
-        cursor.insertText(newText);
+        bulkEdit([&]() { cursor.insertText(newText); });
 
         // update the selection to the new text
         cursor.setPosition(cursor.position() - newText.size(),
@@ -1339,29 +1354,64 @@ QMap<QString, QString> QMarkdownTextEdit::parseMarkdownUrlsFromText(
     // [1]: http://domain
     static QRegularExpression regex5(R"((\[.*?\]\[(.+?)\]))");
     iterator = regex5.globalMatch(text);
+    QHash<QString, QString> referenceUrls;
+    bool referenceUrlsParsed = false;
     while (iterator.hasNext()) {
         QRegularExpressionMatch match = iterator.next();
         QString linkText = match.captured(1);
         QString referenceId = match.captured(2);
 
-        // search for the referenced url in the whole text edit
-        //        QRegularExpression refRegExp(
-        //                "\\[" + QRegularExpression::escape(referenceId) +
-        //                        "\\]: (.+?:\\/\\/.+)");
-        QRegularExpression refRegExp(QStringLiteral("\\[") +
-                                     QRegularExpression::escape(referenceId) +
-                                     QStringLiteral("\\]: (.+)"));
-        QRegularExpressionMatch urlMatch = refRegExp.match(toPlainText());
-
-        if (urlMatch.hasMatch()) {
-            QString url = urlMatch.captured(1);
-            urlMap[linkText] = url;
+        // the highlighter indexes the referenced urls while highlighting,
+        // blocks that weren't highlighted yet are only parsed as fallback
+        if (_highlighter && _highlighter->document() == document()) {
+            const QString url = _highlighter->referenceUrl(referenceId);
+            if (!url.isNull()) {
+                urlMap[linkText] = url;
+                continue;
+            }
+        }
+
+        // parse the referenced urls of the whole text edit only once with
+        // the same pattern, instead of building a pattern for every reference
+        if (!referenceUrlsParsed) {
+            referenceUrls = parseMarkdownReferenceUrls(toPlainText());
+            referenceUrlsParsed = true;
+        }
+
+        const auto it = referenceUrls.constFind(referenceId);
+        if (it != referenceUrls.constEnd()) {
+            urlMap[linkText] = it.value();
         }
     }
 
     return urlMap;
 }
 
+/**
+ * @brief Returns the urls of the reference definitions like
+ * "[1]: http://domain" by their reference ids, the first definition wins
+ *
+ * @param text
+ * @return referenced urls
+ */
+QHash<QString, QString> QMarkdownTextEdit::parseMarkdownReferenceUrls(
+    const QString &text) {
+    QHash<QString, QString> referenceUrls;
+    static const QRegularExpression regex(R"(\[([^\[\]]+)\]: (.+))");
+    QRegularExpressionMatchIterator iterator = regex.globalMatch(text);
+
+    while (iterator.hasNext()) {
+        const QRegularExpressionMatch match = iterator.next();
+        const QString referenceId = match.captured(1);
+
+        if (!referenceUrls.contains(referenceId)) {
+            referenceUrls.insert(referenceId, match.captured(2));
+        }
+    }
+
+    return referenceUrls;
+}
+
 /**
  * @brief Returns the Markdown url at position
  * @param text
@@ -1421,7 +1471,7 @@ void QMarkdownTextEdit::duplicateText() {
 
         // insert text with new line at end of the selected line
         cursor.setPosition(cursor.selectionEnd());
-        cursor.insertText(selectedText);
+        bulkEdit([&]() { cursor.insertText(selectedText); });
 
         // set the position to same position it was in the duplicated line
         cursor.setPosition(cursor.position() - positionDiff);
@@ -1431,7 +1481,7 @@ void QMarkdownTextEdit::duplicateText() {
         const int selectionStart = cursor.position();
 
         // insert selected text
-        cursor.insertText(selectedText);
+        bulkEdit([&]() { cursor.insertText(selectedText); });
         const int selectionEnd = cursor.position();
 
         // select the inserted text
@@ -1453,6 +1503,198 @@ void QMarkdownTextEdit::setPlainText(const QString &text) {
     adjustRightMargin();
 }
 
+/**
+ * Loads a text like setPlainText(), but faster for large texts
+ *
+ * Only the first blocks are highlighted directly, the rest of them is left to
+ * the asynchronous or lazy highlighting (also if neither is enabled) and the
+ * signals and updates while loading are replaced by a single update.
+ * Texts that were loaded before are taken from the cache of highlighted
+ * documents of the highlighter (see MarkdownHighlighter::setStateCacheBudget).
+ *
+ * @param text
+ * @param highlightingState the highlighting of the text serialized by
+ * MarkdownHighlighter::saveDocumentState(), to not highlight it again
+ */
+void QMarkdownTextEdit::loadPlainText(const QString &text,
+                                      const QByteArray &highlightingState) {
+    // switching back to the current text doesn't need to highlight it again,
+    // if the cache of the highlighter is enabled
+    if (_highlighter) _highlighter->cacheDocumentState();
+
+    bulkLoad([this, &text, &highlightingState]() {
+        if (_highlighter && !_highlighter->restoreDocumentState(text) &&
+            !highlightingState.isEmpty()) {
+            _highlighter->restoreDocumentState(highlightingState, text);
+        }
+
+        QPlainTextEdit::setPlainText(text);
+    });
+}
+
+/**
+ * Loads an UTF-8 encoded file with loadPlainText(), the file is mapped into
+ * memory if possible
+ *
+ * @param fileName
+ * @return false if the file couldn't be read or is larger than a QString
+ * can hold
+ */
+bool QMarkdownTextEdit::loadFile(const QString &fileName) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    const qint64 size = file.size();
+    if (size > maxUtf8DataSize) return false;
+
+    uchar *data = size > 0 ? file.map(0, size) : nullptr;
+
+    if (data) {
+        const bool loaded =
+            loadUtf8Data(reinterpret_cast<const char *>(data), size);
+        file.unmap(data);
+        return loaded;
+    }
+
+    const QByteArray content = file.readAll();
+    if (file.error() != QFileDevice::NoError) return false;
+
+    return loadUtf8Data(content.constData(), content.size());
+}
+
+/**
+ * Loads UTF-8 encoded data (like a memory-mapped file) with loadPlainText(),
+ * the data is only used while loading
+ *
+ * @param data
+ * @param size
+ * @return false if the size is negative or larger than a QString can hold
+ */
+bool QMarkdownTextEdit::loadUtf8Data(const char *data, qint64 size) {
+    if (size < 0 || size > maxUtf8DataSize) return false;
+
+    // skip the byte order mark
+    if (size >= 3 && data[0] == '\xEF' && data[1] == '\xBB' &&
+        data[2] == '\xBF') {
+        data += 3;
+        size -= 3;
+    }
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    loadPlainText(QString::fromUtf8(data, static_cast<int>(size)));
+#else
+    loadPlainText(QString::fromUtf8(data, static_cast<qsizetype>(size)));
+#endif
+    return true;
+}
+
+/**
+ * Replaces the document with a prepared document like a loaded text (see
+ * loadPlainText()), the text edit takes ownership of the document
+ *
+ * The document gets a QPlainTextDocumentLayout if it doesn't have one, so it
+ * is best prepared with one, to not lay it out twice.
+ *
+ * @param document
+ */
+void QMarkdownTextEdit::adoptDocument(QTextDocument *document) {
+    if (document == nullptr || document == this->document()) return;
+
+    if (!qobject_cast<QPlainTextDocumentLayout *>(
+            document->documentLayout())) {
+        document->setDocumentLayout(new QPlainTextDocumentLayout(document));
+    }
+
+    // the default document is deleted by setDocument(), only previously
+    // adopted documents are owned by the text edit
+    QPointer<QTextDocument> oldDocument = this->document();
+    const bool ownsOldDocument = oldDocument->parent() == this;
+
+    bulkLoad([this, document, oldDocument]() {
+        disconnect(oldDocument.data(), &QTextDocument::blockCountChanged, this,
+                   &QMarkdownTextEdit::updateLineNumberAreaWidth);
+        setDocument(document);
+        connect(document, &QTextDocument::blockCountChanged, this,
+                &QMarkdownTextEdit::updateLineNumberAreaWidth);
+
+        if (_highlighter && _highlightingEnabled) {
+            _highlighter->setDocument(document);
+
+            // also cancels the delayed rehighlighting of the whole document
+            _highlighter->rehighlight();
+        }
+    });
+
+    document->setParent(this);
+
+    if (ownsOldDocument && oldDocument) oldDocument->deleteLater();
+}
+
+/**
+ * Runs an edit of many blocks (like indenting a large selection) with the
+ * highlighting of most of them deferred, the line numbers and the right
+ * margin are updated once afterwards instead of for every changed block
+ *
+ * @param edit
+ */
+void QMarkdownTextEdit::bulkEdit(const std::function<void()> &edit) {
+    if (_highlighter) {
+        _highlighter->deferNextBurst();
+    }
+
+    _bulkLoading = true;
+    edit();
+    _bulkLoading = false;
+
+    updateLineNumberAreaWidth(0);
+    _lineNumArea->update();
+    adjustRightMargin();
+}
+
+/**
+ * Runs a function that loads a text or a document, with highlighting most of
+ * it deferred and without intermediate signals and updates of the text edit
+ *
+ * Afterwards the signals about the new text and its states are emitted once,
+ * like setPlainText() and setDocument() do.
+ *
+ * @param load
+ */
+void QMarkdownTextEdit::bulkLoad(const std::function<void()> &load) {
+    if (_highlighter) {
+        // prevents a possible crash in QSyntaxHighlighter::rehighlightBlock
+        _highlighter->clearDirtyBlocks();
+        _highlighter->deferNextBurst();
+    }
+
+    const bool updatesWereEnabled = updatesEnabled();
+    setUpdatesEnabled(false);
+    _bulkLoading = true;
+
+    {
+        const QSignalBlocker blocker(this);
+        load();
+    }
+
+    _bulkLoading = false;
+    setUpdatesEnabled(updatesWereEnabled);
+
+    // the line numbers and the right margin are updated once
+    _textCursor = textCursor();
+    updateLineNumberAreaWidth(0);
+    _lineNumArea->update();
+
+    const QTextDocument *document = this->document();
+    const bool hasSelection = _textCursor.hasSelection();
+    Q_EMIT undoAvailable(document->isUndoAvailable());
+    Q_EMIT redoAvailable(document->isRedoAvailable());
+    Q_EMIT modificationChanged(document->isModified());
+    Q_EMIT copyAvailable(hasSelection);
+    Q_EMIT selectionChanged();
+    Q_EMIT textChanged();
+    Q_EMIT cursorPositionChanged();
+}
+
 /**
  * Uses another widget as parent for the search widget
  */
@@ -1657,7 +1899,7 @@ bool QMarkdownTextEdit::handleTabEntered(bool reverse,
     QTextCursor cursor = this->textCursor();
 
     // only check for lists if we haven't a text selected
-    if (cursor.selectedText().isEmpty()) {
+    if (!cursor.hasSelection()) {
         cursor.movePosition(QTextCursor::StartOfBlock, QTextCursor::KeepAnchor);
         const QString currentLineText = cursor.selectedText();
 
@@ -1727,6 +1969,8 @@ void QMarkdownTextEdit::setAutoTextOptions(AutoTextOptions options) {
 }
 
 void QMarkdownTextEdit::updateLineNumberArea(const QRect rect, int dy) {
+    if (_bulkLoading) return;
+
     if (dy)
         _lineNumArea->scroll(0, dy);
     else
@@ -1741,7 +1985,10 @@ void QMarkdownTextEdit::updateLineNumberArea(const QRect rect, int dy) {
 }
 
 void QMarkdownTextEdit::updateLineNumberAreaWidth(int) {
+    if (_bulkLoading) return;
+
     QSignalBlocker blocker(this);
+    _lineNumArea->updateWidth();
     const auto oldMargins = viewportMargins();
     const int width =
         _lineNumArea->isLineNumAreaEnabled()
@@ -1772,7 +2019,14 @@ void QMarkdownTextEdit::updateLineNumberAreaWidth(int) {
  * modifications and minor improvements for our use
  */
 void QMarkdownTextEdit::paintEvent(QPaintEvent *e) {
+#ifdef QMARKDOWNTEXTEDIT_INSTRUMENTATION
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+#endif
+
     QTextBlock block = firstVisibleBlock();
+    const int firstVisibleBlockNumber = block.blockNumber();
+    int lastVisibleBlockNumber = firstVisibleBlockNumber;
 
     QPainter painter(viewport());
     const QRect viewportRect = viewport()->rect();
@@ -1789,6 +2043,23 @@ void QMarkdownTextEdit::paintEvent(QPaintEvent *e) {
 
     const QColor &color = MarkdownHighlighter::codeBlockBackgroundColor();
     const int cornerRadius = 5;
+    const QTextCursor cursor = textCursor();
+    const QTextBlock cursorBlock = cursor.block();
+    const QTextBlock lastBlock = document()->lastBlock();
+
+    // the highlighter caches the properties of the blocks that otherwise
+    // would need their text
+    auto isCodeBlockFence = [this](const QTextBlock &block) {
+        if (_highlighter) return _highlighter->isCodeBlockFence(block);
+
+        const QString text = block.text();
+        return text.startsWith(QLatin1String("```")) ||
+               text.startsWith(QLatin1String("~~~"));
+    };
+    auto isRightToLeft = [this](const QTextBlock &block) {
+        return _highlighter ? _highlighter->isRightToLeft(block)
+                            : block.text().isRightToLeft();
+    };
 
     while (block.isValid() && !done) {
         const QRectF r = blockBoundingRect(block).translated(offset);
@@ -1796,8 +2067,7 @@ void QMarkdownTextEdit::paintEvent(QPaintEvent *e) {
 
         if (!inBlockArea && MarkdownHighlighter::isCodeBlock(state)) {
             // skip the backticks
-            if (!block.text().startsWith(QLatin1String("```")) &&
-                !block.text().startsWith(QLatin1String("~~~"))) {
+            if (!isCodeBlockFence(block)) {
                 blockAreaRect = r;
                 dy = 0.0;
                 inBlockArea = true;
@@ -1823,7 +2093,7 @@ void QMarkdownTextEdit::paintEvent(QPaintEvent *e) {
         // If the block is at the end of the document and ends a text
         // block area...
         //
-        if (inBlockArea && block == this->document()->lastBlock()) {
+        if (inBlockArea && block == lastBlock) {
             drawBlock = true;
             inBlockArea = false;
             dy += r.height();
@@ -1832,16 +2102,6 @@ void QMarkdownTextEdit::paintEvent(QPaintEvent *e) {
         offset.ry() += r.height();
         dy += r.height();
 
-        // If this is the last text block visible within the viewport...
-        if (offset.y() > viewportRect.height()) {
-            if (inBlockArea) {
-                blockAreaRect.setHeight(dy);
-                drawBlock = true;
-            }
-
-            // Finished drawing.
-            done = true;
-        }
         // If this is the last text block visible within the viewport...
         if (offset.y() > viewportRect.height()) {
             if (inBlockArea) {
@@ -1863,13 +2123,15 @@ void QMarkdownTextEdit::paintEvent(QPaintEvent *e) {
             // to reflect that the first visible block is part of a larger block
             // of text.
             //
+            // The color is opaque, so the square top half can just be drawn
+            // over the rounded rectangle instead of simplifying a path.
+            //
             if (clipTop) {
-                QPainterPath path;
-                path.setFillRule(Qt::WindingFill);
-                path.addRoundedRect(blockAreaRect, cornerRadius, cornerRadius);
+                painter.drawRoundedRect(blockAreaRect, cornerRadius,
+                                        cornerRadius);
                 qreal adjustedHeight = blockAreaRect.height() / 2;
-                path.addRect(blockAreaRect.adjusted(0, 0, 0, -adjustedHeight));
-                painter.drawPath(path.simplified());
+                painter.drawRect(
+                    blockAreaRect.adjusted(0, 0, 0, -adjustedHeight));
                 clipTop = false;
             }
             // Else draw the entire rectangle with all corners rounded.
@@ -1883,7 +2145,7 @@ void QMarkdownTextEdit::paintEvent(QPaintEvent *e) {
 
         // this fixes the RTL bug of QPlainTextEdit
         // https://bugreports.qt.io/browse/QTBUG-7516
-        if (block.text().isRightToLeft()) {
+        if (isRightToLeft(block)) {
             QTextLayout *layout = block.layout();
             // opt = document()->defaultTextOption();
             QTextOption opt = QTextOption(Qt::AlignRight);
@@ -1892,8 +2154,7 @@ void QMarkdownTextEdit::paintEvent(QPaintEvent *e) {
         }
 
         // Current line highlight
-        QTextCursor cursor = textCursor();
-        if (highlightCurrentLine() && cursor.block() == block) {
+        if (highlightCurrentLine() && cursorBlock == block) {
             QTextLine line =
                 block.layout()->lineForTextPosition(cursor.positionInBlock());
             QRectF lineRect = line.rect();
@@ -1904,12 +2165,36 @@ void QMarkdownTextEdit::paintEvent(QPaintEvent *e) {
                              currentLineHighlightColor());
         }
 
+        lastVisibleBlockNumber = block.blockNumber();
         block = block.next();
         firstVisible = false;
     }
 
     painter.end();
     QPlainTextEdit::paintEvent(e);
+
+    // let the highlighter highlight the visible blocks first
+    if (_highlighter) {
+        _highlighter->setVisibleBlockRange(firstVisibleBlockNumber,
+                                           lastVisibleBlockNumber);
+    }
+
+#ifdef QMARKDOWNTEXTEDIT_INSTRUMENTATION
+    ++_paintStatistics.calls;
+    _paintStatistics.nsecs += paintTimer.nsecsElapsed();
+    for (QTextBlock b = firstVisibleBlock();
+         b.isValid() && b.blockNumber() <= lastVisibleBlockNumber;
+         b = b.next()) {
+        _paintStatistics.characters += b.length();
+    }
+#endif
+}
+
+/**
+ * Resets the paint statistics of the instrumentation
+ */
+void QMarkdownTextEdit::resetPaintStatistics() {
+    _paintStatistics = MarkdownHighlighter::PhaseStatistics();
 }
 
 /**
@@ -26,6 +26,7 @@
 
 #include <QEvent>
 #include <QPlainTextEdit>
+#include <functional>
 
 #include "markdownhighlighter.h"
 #include "qplaintexteditsearchwidget.h"
@@ -82,6 +83,18 @@ class QMarkdownTextEdit : public QPlainTextEdit {
     void setCurrentLineHighlightColor(const QColor &c);
     QColor currentLineHighlightColor();
 
+    void loadPlainText(const QString &text,
+                       const QByteArray &highlightingState = QByteArray());
+    bool loadFile(const QString &fileName);
+    bool loadUtf8Data(const char *data, qint64 size);
+    void adoptDocument(QTextDocument *document);
+
+    inline const MarkdownHighlighter::PhaseStatistics &paintStatistics()
+        const {
+        return _paintStatistics;
+    }
+    void resetPaintStatistics();
+
    public Q_SLOTS:
     void duplicateText();
     void setText(const QString &text);
@@ -108,6 +121,9 @@ class QMarkdownTextEdit : public QPlainTextEdit {
     bool _highlightCurrentLine = false;
     QColor _currentLineHighlightColor = QColor();
     uint _debounceDelay = 0;
+    bool _bulkLoading = false;
+    // only recorded if the library is built with instrumentation
+    MarkdownHighlighter::PhaseStatistics _paintStatistics;
 
     bool eventFilter(QObject *obj, QEvent *event) override;
     QMargins viewportMargins();
@@ -117,6 +133,10 @@ class QMarkdownTextEdit : public QPlainTextEdit {
     bool handleTabEntered(bool reverse, const QString &indentCharacters =
                                             QChar::fromLatin1('\t'));
     QMap<QString, QString> parseMarkdownUrlsFromText(const QString &text);
+    static QHash<QString, QString> parseMarkdownReferenceUrls(
+        const QString &text);
+    void bulkLoad(const std::function<void()> &load);
+    void bulkEdit(const std::function<void()> &edit);
     bool handleReturnEntered();
     bool handleBracketClosing(const QChar openingCharacter,
                               QChar closingCharacter = QChar());
@@ -26,11 +26,236 @@
 
 #include <QLatin1String>
 #include <QMultiHash>
+#include <algorithm>
+#include <cstring>
+
+static bool isIdentifierChar(const QChar c) {
+    return c.isLetterOrNumber() || c == QLatin1Char('_');
+}
+
+/**
+ * Compares the text at `pos` (with `len` characters) to `word`, in the same
+ * order that compareEntries() uses
+ */
+static int compareToWord(const QString &text, int pos, int len,
+                         QLatin1String word) {
+    const int wordLen = static_cast<int>(word.size());
+    const int n = std::min(len, wordLen);
+    for (int i = 0; i < n; ++i) {
+        const ushort a = text.at(pos + i).unicode();
+        const ushort b = static_cast<uchar>(word.data()[i]);
+        if (a != b) return a < b ? -1 : 1;
+    }
+    return len == wordLen ? 0 : (len < wordLen ? -1 : 1);
+}
+
+static bool compareEntries(const LanguageData::Entry &a,
+                           const LanguageData::Entry &b) {
+    const int n = static_cast<int>(std::min(a.word.size(), b.word.size()));
+    const int r = std::memcmp(a.word.data(), b.word.data(), n);
+    if (r != 0) return r < 0;
+    if (a.word.size() != b.word.size()) return a.word.size() < b.word.size();
+    return a.type < b.type;
+}
+
+/**
+ * Sorts the entries and removes duplicate words, keeping the word with the
+ * highest priority
+ */
+static void sortEntries(QVector<LanguageData::Entry> &entries) {
+    std::sort(entries.begin(), entries.end(), compareEntries);
+    auto last = std::unique(
+        entries.begin(), entries.end(),
+        [](const LanguageData::Entry &a, const LanguageData::Entry &b) {
+            return a.word == b.word;
+        });
+    entries.erase(last, entries.end());
+}
+
+/**
+ * Adds the words of `hash` to `words` or, if they contain more than the
+ * characters accepted by `isWordChar`, to `irregularWords`
+ */
+static void addWords(const QMultiHash<char, QLatin1String> &hash,
+                     LanguageData::WordType type,
+                     QVector<LanguageData::Entry> &words,
+                     QVector<LanguageData::Entry> &irregularWords,
+                     bool (*isWordChar)(QChar)) {
+    for (auto it = hash.cbegin(); it != hash.cend(); ++it) {
+        const QLatin1String word = it.value();
+        if (word.size() == 0) continue;
+
+        const LanguageData::Entry entry = {word, type};
+        bool regular = true;
+        for (int i = 0; i < word.size(); ++i) {
+            if (!isWordChar(QLatin1Char(word.data()[i]))) {
+                regular = false;
+                break;
+            }
+        }
+
+        if (regular) {
+            words.append(entry);
+        } else {
+            irregularWords.append(entry);
+        }
+    }
+}
+
+/**
+ * Binary search for the word [pos, pos + len) in the sorted `words`
+ */
+static const LanguageData::Entry *findWord(
+    const QVector<LanguageData::Entry> &words, const QString &text, int pos,
+    int len) {
+    int low = 0;
+    int high = words.size() - 1;
+    while (low <= high) {
+        const int mid = (low + high) / 2;
+        const int r = compareToWord(text, pos, len, words.at(mid).word);
+        if (r == 0) return &words.at(mid);
+        if (r < 0) {
+            high = mid - 1;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Finds the best irregular word that matches at `pos` and ends at a word
+ * boundary, `bestType` is set to the word type of that match
+ */
+static int matchIrregularWord(const QVector<LanguageData::Entry> &words,
+                              const QString &text, int pos,
+                              LanguageData::WordType &bestType,
+                              bool (*isWordChar)(QChar)) {
+    const QChar first = text.at(pos);
+    if (first.unicode() > 0xff) return 0;
+
+    // words are sorted, so all words with the same first character are
+    // next to each other
+    const char c = static_cast<char>(first.unicode());
+    auto it = std::lower_bound(
+        words.cbegin(), words.cend(), c,
+        [](const LanguageData::Entry &e, char ch) {
+            return static_cast<uchar>(e.word.data()[0]) <
+                   static_cast<uchar>(ch);
+        });
+
+    int bestLen = 0;
+    const int textLen = text.length();
+    for (; it != words.cend() && it->word.data()[0] == c; ++it) {
+        const int wordLen = static_cast<int>(it->word.size());
+        if (pos + wordLen > textLen) continue;
+        if (bestLen > 0 && it->type > bestType) continue;
+        if (compareToWord(text, pos, wordLen, it->word) != 0) continue;
+        if (pos + wordLen < textLen && isWordChar(text.at(pos + wordLen)))
+            continue;
+
+        if (bestLen == 0 || it->type < bestType || wordLen > bestLen) {
+            bestLen = wordLen;
+            bestType = it->type;
+        }
+    }
+    return bestLen;
+}
+
+static bool isLetter(const QChar c) { return c.isLetter(); }
+
+LanguageData::LanguageData(const QMultiHash<char, QLatin1String> &types,
+                           const QMultiHash<char, QLatin1String> &keywords,
+                           const QMultiHash<char, QLatin1String> &builtin,
+                           const QMultiHash<char, QLatin1String> &literals,
+                           const QMultiHash<char, QLatin1String> &other) {
+    addWords(types, Type, _words, _irregularWords, isIdentifierChar);
+    addWords(keywords, Keyword, _words, _irregularWords, isIdentifierChar);
+    addWords(literals, Literal, _words, _irregularWords, isIdentifierChar);
+    addWords(builtin, Builtin, _words, _irregularWords, isIdentifierChar);
+    addWords(other, Other, _otherWords, _irregularOtherWords, isLetter);
+
+    sortEntries(_words);
+    sortEntries(_irregularWords);
+    sortEntries(_otherWords);
+    sortEntries(_irregularOtherWords);
+}
+
+int LanguageData::matchWord(const QString &text, int pos,
+                            WordType &type) const {
+    // the identifier under the cursor
+    int end = pos;
+    while (end < text.length() && isIdentifierChar(text.at(end))) ++end;
+
+    int len = 0;
+    const Entry *entry = findWord(_words, text, pos, end - pos);
+    if (entry) {
+        len = end - pos;
+        type = entry->type;
+    }
+
+    if (!_irregularWords.isEmpty()) {
+        WordType irregularType = NoWord;
+        const int irregularLen = matchIrregularWord(
+            _irregularWords, text, pos, irregularType, isIdentifierChar);
+        if (irregularLen > 0 && (len == 0 || irregularType <= type)) {
+            len = irregularLen;
+            type = irregularType;
+        }
+    }
+
+    return len;
+}
+
+int LanguageData::matchOther(const QString &text, int pos) const {
+    int end = pos;
+    while (end < text.length() && text.at(end).isLetter()) ++end;
+
+    int len = findWord(_otherWords, text, pos, end - pos) ? end - pos : 0;
+
+    if (!_irregularOtherWords.isEmpty()) {
+        WordType type = Other;
+        const int irregularLen = matchIrregularWord(
+            _irregularOtherWords, text, pos, type, isLetter);
+        if (irregularLen > 0) len = irregularLen;
+    }
+
+    return len;
+}
+/**
+ * Builds the language data from the word hashes of a language and frees the
+ * hashes, they are only needed once and the words of the language data point
+ * to the string literals directly
+ */
+static LanguageData takeLanguageData(QMultiHash<char, QLatin1String> &types,
+                                     QMultiHash<char, QLatin1String> &keywords,
+                                     QMultiHash<char, QLatin1String> &builtin,
+                                     QMultiHash<char, QLatin1String> &literals,
+                                     QMultiHash<char, QLatin1String> &other) {
+    const LanguageData data(types, keywords, builtin, literals, other);
+    types = QMultiHash<char, QLatin1String>();
+    keywords = QMultiHash<char, QLatin1String>();
+    builtin = QMultiHash<char, QLatin1String>();
+    literals = QMultiHash<char, QLatin1String>();
+    other = QMultiHash<char, QLatin1String>();
+    return data;
+}
+
+/**
+ * Defines the loader of a language that was excluded from the build, its
+ * code blocks are highlighted without words
+ */
+#define QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loader)         \
+    const LanguageData &loader() {                          \
+        static const LanguageData data({}, {}, {}, {}, {}); \
+        return data;                                        \
+    }
+
 /* ------------------------
  * TEMPLATE FOR LANG DATA
  * -------------------------
  *
- * loadXXXData, where XXX is the language
+ * loadXXXData, where XXX is the language, returns its LanguageData
  * keywords are the language keywords e.g, const
  * types are built-in types i.e, int, char, var
  * literals are words like, true false
@@ -59,7 +284,7 @@
 /* C/C++ Data *********************************************/
 /**********************************************************/
 
-static bool cppDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_CPP
 static QMultiHash<char, QLatin1String> cpp_keywords;
 static QMultiHash<char, QLatin1String> cpp_types;
 static QMultiHash<char, QLatin1String> cpp_builtin;
@@ -317,28 +542,23 @@ void initCppData() {
         {('p'), QLatin1String("pragma")},  {('P'), QLatin1String("_Pragma")},
         {('u'), QLatin1String("undef")},   {('w'), QLatin1String("warning")}};
 }
-void loadCppData(QMultiHash<char, QLatin1String> &typess,
-                 QMultiHash<char, QLatin1String> &keywordss,
-                 QMultiHash<char, QLatin1String> &builtins,
-                 QMultiHash<char, QLatin1String> &literalss,
-                 QMultiHash<char, QLatin1String> &others) {
-    if (!cppDataInitialized) {
+const LanguageData &loadCppData() {
+    static const LanguageData data = []() {
         initCppData();
-        cppDataInitialized = true;
-    }
-
-    typess = cpp_types;
-    keywordss = cpp_keywords;
-    builtins = cpp_builtin;
-    literalss = cpp_literals;
-    others = cpp_other;
+        return takeLanguageData(cpp_types, cpp_keywords, cpp_builtin,
+                                cpp_literals, cpp_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadCppData)
+#endif
 
 /**********************************************************/
 /* Shell Data *********************************************/
 /**********************************************************/
 
-static bool shellDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_SHELL
 static QMultiHash<char, QLatin1String> shell_keywords;
 static QMultiHash<char, QLatin1String> shell_types;
 static QMultiHash<char, QLatin1String> shell_literals;
@@ -499,26 +719,22 @@ void initShellData() {
     shell_other = {};
 }
 
-void loadShellData(QMultiHash<char, QLatin1String> &types,
-                   QMultiHash<char, QLatin1String> &keywords,
-                   QMultiHash<char, QLatin1String> &builtin,
-                   QMultiHash<char, QLatin1String> &literals,
-                   QMultiHash<char, QLatin1String> &other) {
-    if (!shellDataInitialized) {
+const LanguageData &loadShellData() {
+    static const LanguageData data = []() {
         initShellData();
-        shellDataInitialized = true;
-    }
-    types = shell_types;
-    keywords = shell_keywords;
-    builtin = shell_builtin;
-    literals = shell_literals;
-    other = shell_other;
+        return takeLanguageData(shell_types, shell_keywords, shell_builtin,
+                                shell_literals, shell_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadShellData)
+#endif
 
 /**********************************************************/
 /* JS Data *********************************************/
 /**********************************************************/
-static bool JSDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_JS
 static QMultiHash<char, QLatin1String> js_keywords;
 static QMultiHash<char, QLatin1String> js_types;
 static QMultiHash<char, QLatin1String> js_literals;
@@ -637,26 +853,22 @@ void initJSData() {
     js_other = {};
 }
 
-void loadJSData(QMultiHash<char, QLatin1String> &types,
-                QMultiHash<char, QLatin1String> &keywords,
-                QMultiHash<char, QLatin1String> &builtin,
-                QMultiHash<char, QLatin1String> &literals,
-                QMultiHash<char, QLatin1String> &other) {
-    if (!JSDataInitialized) {
+const LanguageData &loadJSData() {
+    static const LanguageData data = []() {
         initJSData();
-        JSDataInitialized = true;
-    }
-    types = js_types;
-    keywords = js_keywords;
-    builtin = js_builtin;
-    literals = js_literals;
-    other = js_other;
+        return takeLanguageData(js_types, js_keywords, js_builtin, js_literals,
+                                js_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadJSData)
+#endif
 
 /**********************************************************/
 /* Nix Data ***********************************************/
 /**********************************************************/
-static bool NixDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_NIX
 static QMultiHash<char, QLatin1String> nix_keywords;
 static QMultiHash<char, QLatin1String> nix_types;
 static QMultiHash<char, QLatin1String> nix_literals;
@@ -710,26 +922,22 @@ void initNixData() {
     };
 }
 
-void loadNixData(QMultiHash<char, QLatin1String> &types,
-                 QMultiHash<char, QLatin1String> &keywords,
-                 QMultiHash<char, QLatin1String> &builtin,
-                 QMultiHash<char, QLatin1String> &literals,
-                 QMultiHash<char, QLatin1String> &other) {
-    if (!NixDataInitialized) {
+const LanguageData &loadNixData() {
+    static const LanguageData data = []() {
         initNixData();
-        NixDataInitialized = true;
-    }
-    types = nix_types;
-    keywords = nix_keywords;
-    builtin = nix_builtin;
-    literals = nix_literals;
-    other = nix_other;
+        return takeLanguageData(nix_types, nix_keywords, nix_builtin,
+                                nix_literals, nix_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadNixData)
+#endif
 
 /**********************************************************/
 /* PHP Data *********************************************/
 /**********************************************************/
-static bool PHPDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_PHP
 static QMultiHash<char, QLatin1String> php_keywords;
 static QMultiHash<char, QLatin1String> php_types;
 static QMultiHash<char, QLatin1String> php_literals;
@@ -834,26 +1042,22 @@ void initPHPData() {
                  {('p'), QLatin1String("php_errormsg")},
                  {('h'), QLatin1String("http_response_header")}};
 }
-void loadPHPData(QMultiHash<char, QLatin1String> &types,
-                 QMultiHash<char, QLatin1String> &keywords,
-                 QMultiHash<char, QLatin1String> &builtin,
-                 QMultiHash<char, QLatin1String> &literals,
-                 QMultiHash<char, QLatin1String> &other) {
-    if (!PHPDataInitialized) {
+const LanguageData &loadPHPData() {
+    static const LanguageData data = []() {
         initPHPData();
-        PHPDataInitialized = true;
-    }
-    types = php_types;
-    keywords = php_keywords;
-    builtin = php_builtin;
-    literals = php_literals;
-    other = php_other;
+        return takeLanguageData(php_types, php_keywords, php_builtin,
+                                php_literals, php_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadPHPData)
+#endif
 
 /**********************************************************/
 /* QML Data *********************************************/
 /**********************************************************/
-static bool QMLDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_QML
 static QMultiHash<char, QLatin1String> qml_keywords;
 static QMultiHash<char, QLatin1String> qml_types;
 static QMultiHash<char, QLatin1String> qml_literals;
@@ -970,26 +1174,22 @@ void initQMLData() {
 
     qml_other = {{('i'), QLatin1String("import")}};
 }
-void loadQMLData(QMultiHash<char, QLatin1String> &types,
-                 QMultiHash<char, QLatin1String> &keywords,
-                 QMultiHash<char, QLatin1String> &builtin,
-                 QMultiHash<char, QLatin1String> &literals,
-                 QMultiHash<char, QLatin1String> &other) {
-    if (!QMLDataInitialized) {
+const LanguageData &loadQMLData() {
+    static const LanguageData data = []() {
         initQMLData();
-        QMLDataInitialized = true;
-    }
-    types = qml_types;
-    keywords = qml_keywords;
-    builtin = qml_builtin;
-    literals = qml_literals;
-    other = qml_other;
+        return takeLanguageData(qml_types, qml_keywords, qml_builtin,
+                                qml_literals, qml_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadQMLData)
+#endif
 
 /**********************************************************/
 /* Python Data *********************************************/
 /**********************************************************/
-static bool PyDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_PYTHON
 static QMultiHash<char, QLatin1String> py_keywords;
 static QMultiHash<char, QLatin1String> py_types;
 static QMultiHash<char, QLatin1String> py_literals;
@@ -1109,26 +1309,22 @@ void initPyData() {
 
     py_other = {{('i'), QLatin1String("import")}};
 }
-void loadPythonData(QMultiHash<char, QLatin1String> &types,
-                    QMultiHash<char, QLatin1String> &keywords,
-                    QMultiHash<char, QLatin1String> &builtin,
-                    QMultiHash<char, QLatin1String> &literals,
-                    QMultiHash<char, QLatin1String> &other) {
-    if (!PyDataInitialized) {
+const LanguageData &loadPythonData() {
+    static const LanguageData data = []() {
         initPyData();
-        PyDataInitialized = true;
-    }
-    types = py_types;
-    keywords = py_keywords;
-    builtin = py_builtin;
-    literals = py_literals;
-    other = py_other;
+        return takeLanguageData(py_types, py_keywords, py_builtin, py_literals,
+                                py_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadPythonData)
+#endif
 
 /********************************************************/
 /***   Rust DATA      ***********************************/
 /********************************************************/
-static bool rustDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_RUST
 static QMultiHash<char, QLatin1String> rust_keywords;
 static QMultiHash<char, QLatin1String> rust_types;
 static QMultiHash<char, QLatin1String> rust_literals;
@@ -1221,26 +1417,22 @@ void initRustData() {
                   {('a'), QLatin1String("assert_ne!")},
                   {('d'), QLatin1String("debug_assert_ne!")}};
 }
-void loadRustData(QMultiHash<char, QLatin1String> &types,
-                  QMultiHash<char, QLatin1String> &keywords,
-                  QMultiHash<char, QLatin1String> &builtin,
-                  QMultiHash<char, QLatin1String> &literals,
-                  QMultiHash<char, QLatin1String> &other) {
-    if (!rustDataInitialized) {
+const LanguageData &loadRustData() {
+    static const LanguageData data = []() {
         initRustData();
-        rustDataInitialized = true;
-    }
-    types = rust_types;
-    keywords = rust_keywords;
-    builtin = rust_builtin;
-    literals = rust_literals;
-    other = rust_other;
+        return takeLanguageData(rust_types, rust_keywords, rust_builtin,
+                                rust_literals, rust_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadRustData)
+#endif
 
 /********************************************************/
 /***   Java DATA      ***********************************/
 /********************************************************/
-static bool javaDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_JAVA
 static QMultiHash<char, QLatin1String> java_keywords;
 static QMultiHash<char, QLatin1String> java_types;
 static QMultiHash<char, QLatin1String> java_literals;
@@ -1321,26 +1513,22 @@ void initJavaData() {
 
     };
 }
-void loadJavaData(QMultiHash<char, QLatin1String> &types,
-                  QMultiHash<char, QLatin1String> &keywords,
-                  QMultiHash<char, QLatin1String> &builtin,
-                  QMultiHash<char, QLatin1String> &literals,
-                  QMultiHash<char, QLatin1String> &other) {
-    if (!javaDataInitialized) {
+const LanguageData &loadJavaData() {
+    static const LanguageData data = []() {
         initJavaData();
-        javaDataInitialized = true;
-    }
-    types = java_types;
-    keywords = java_keywords;
-    builtin = java_builtin;
-    literals = java_literals;
-    other = java_other;
+        return takeLanguageData(java_types, java_keywords, java_builtin,
+                                java_literals, java_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadJavaData)
+#endif
 
 /********************************************************/
 /***   C# DATA      *************************************/
 /********************************************************/
-static bool csharpDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_CSHARP
 static QMultiHash<char, QLatin1String> csharp_keywords;
 static QMultiHash<char, QLatin1String> csharp_types;
 static QMultiHash<char, QLatin1String> csharp_literals;
@@ -1456,26 +1644,22 @@ void initCSharpData() {
         {('p'), QLatin1String("pragma")},    {('r'), QLatin1String("region")},
         {('u'), QLatin1String("undef")},     {('w'), QLatin1String("warning")}};
 }
-void loadCSharpData(QMultiHash<char, QLatin1String> &types,
-                    QMultiHash<char, QLatin1String> &keywords,
-                    QMultiHash<char, QLatin1String> &builtin,
-                    QMultiHash<char, QLatin1String> &literals,
-                    QMultiHash<char, QLatin1String> &other) {
-    if (!csharpDataInitialized) {
+const LanguageData &loadCSharpData() {
+    static const LanguageData data = []() {
         initCSharpData();
-        csharpDataInitialized = true;
-    }
-    types = csharp_types;
-    keywords = csharp_keywords;
-    builtin = csharp_builtin;
-    literals = csharp_literals;
-    other = csharp_other;
+        return takeLanguageData(csharp_types, csharp_keywords, csharp_builtin,
+                                csharp_literals, csharp_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadCSharpData)
+#endif
 
 /********************************************************/
 /***   Go DATA      *************************************/
 /********************************************************/
-static bool goDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_GO
 static QMultiHash<char, QLatin1String> go_keywords;
 static QMultiHash<char, QLatin1String> go_types;
 static QMultiHash<char, QLatin1String> go_literals;
@@ -1550,26 +1734,22 @@ void initGoData() {
 
     };
 }
-void loadGoData(QMultiHash<char, QLatin1String> &types,
-                QMultiHash<char, QLatin1String> &keywords,
-                QMultiHash<char, QLatin1String> &builtin,
-                QMultiHash<char, QLatin1String> &literals,
-                QMultiHash<char, QLatin1String> &other) {
-    if (!goDataInitialized) {
+const LanguageData &loadGoData() {
+    static const LanguageData data = []() {
         initGoData();
-        goDataInitialized = true;
-    }
-    types = go_types;
-    keywords = go_keywords;
-    builtin = go_builtin;
-    literals = go_literals;
-    other = go_other;
+        return takeLanguageData(go_types, go_keywords, go_builtin, go_literals,
+                                go_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadGoData)
+#endif
 
 /********************************************************/
 /***   V DATA      **************************************/
 /********************************************************/
-static bool vDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_V
 static QMultiHash<char, QLatin1String> v_keywords;
 static QMultiHash<char, QLatin1String> v_types;
 static QMultiHash<char, QLatin1String> v_literals;
@@ -1611,26 +1791,22 @@ void initVData() {
 
     };
 }
-void loadVData(QMultiHash<char, QLatin1String> &types,
-               QMultiHash<char, QLatin1String> &keywords,
-               QMultiHash<char, QLatin1String> &builtin,
-               QMultiHash<char, QLatin1String> &literals,
-               QMultiHash<char, QLatin1String> &other) {
-    if (!vDataInitialized) {
+const LanguageData &loadVData() {
+    static const LanguageData data = []() {
         initVData();
-        vDataInitialized = true;
-    }
-    types = v_types;
-    keywords = v_keywords;
-    builtin = v_builtin;
-    literals = v_literals;
-    other = v_other;
+        return takeLanguageData(v_types, v_keywords, v_builtin, v_literals,
+                                v_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadVData)
+#endif
 
 /********************************************************/
 /***   SQL DATA      ************************************/
 /********************************************************/
-static bool sqlDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_SQL
 static QMultiHash<char, QLatin1String> sql_keywords;
 static QMultiHash<char, QLatin1String> sql_types;
 static QMultiHash<char, QLatin1String> sql_literals;
@@ -1970,26 +2146,22 @@ void initSQLData() {
 
     };
 }
-void loadSQLData(QMultiHash<char, QLatin1String> &types,
-                 QMultiHash<char, QLatin1String> &keywords,
-                 QMultiHash<char, QLatin1String> &builtin,
-                 QMultiHash<char, QLatin1String> &literals,
-                 QMultiHash<char, QLatin1String> &other) {
-    if (!sqlDataInitialized) {
+const LanguageData &loadSQLData() {
+    static const LanguageData data = []() {
         initSQLData();
-        sqlDataInitialized = true;
-    }
-    types = sql_types;
-    keywords = sql_keywords;
-    builtin = sql_builtin;
-    literals = sql_literals;
-    other = sql_other;
+        return takeLanguageData(sql_types, sql_keywords, sql_builtin,
+                                sql_literals, sql_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadSQLData)
+#endif
 
 /********************************************************/
 /***   System Verilog DATA      *************************/
 /********************************************************/
-static bool systemverilogDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_SYSTEMVERILOG
 static QMultiHash<char, QLatin1String> systemverilog_keywords;
 static QMultiHash<char, QLatin1String> systemverilog_types;
 static QMultiHash<char, QLatin1String> systemverilog_literals;
@@ -2248,26 +2420,23 @@ void initSystemVerilogData() {
         {('a'), QLatin1String("always_latch")},
     };
 }
-void loadSystemVerilogData(QMultiHash<char, QLatin1String> &types,
-                           QMultiHash<char, QLatin1String> &keywords,
-                           QMultiHash<char, QLatin1String> &builtin,
-                           QMultiHash<char, QLatin1String> &literals,
-                           QMultiHash<char, QLatin1String> &other) {
-    if (!systemverilogDataInitialized) {
+const LanguageData &loadSystemVerilogData() {
+    static const LanguageData data = []() {
         initSystemVerilogData();
-        systemverilogDataInitialized = true;
-    }
-    types = systemverilog_types;
-    keywords = systemverilog_keywords;
-    builtin = systemverilog_builtin;
-    literals = systemverilog_literals;
-    other = systemverilog_other;
+        return takeLanguageData(systemverilog_types, systemverilog_keywords,
+                                systemverilog_builtin, systemverilog_literals,
+                                systemverilog_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadSystemVerilogData)
+#endif
 
 /********************************************************/
 /***   JSON DATA      ***********************************/
 /********************************************************/
-static bool jsonDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_JSON
 static QMultiHash<char, QLatin1String> json_keywords;
 static QMultiHash<char, QLatin1String> json_types;
 static QMultiHash<char, QLatin1String> json_literals;
@@ -2286,26 +2455,22 @@ void initJSONData() {
 
     json_other = {};
 }
-void loadJSONData(QMultiHash<char, QLatin1String> &types,
-                  QMultiHash<char, QLatin1String> &keywords,
-                  QMultiHash<char, QLatin1String> &builtin,
-                  QMultiHash<char, QLatin1String> &literals,
-                  QMultiHash<char, QLatin1String> &other) {
-    if (!jsonDataInitialized) {
+const LanguageData &loadJSONData() {
+    static const LanguageData data = []() {
         initJSONData();
-        jsonDataInitialized = true;
-    }
-    types = json_types;
-    keywords = json_keywords;
-    builtin = json_builtin;
-    literals = json_literals;
-    other = json_other;
+        return takeLanguageData(json_types, json_keywords, json_builtin,
+                                json_literals, json_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadJSONData)
+#endif
 
 /********************************************************/
 /***   CSS DATA      ***********************************/
 /********************************************************/
-static bool cssDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_CSS
 static QMultiHash<char, QLatin1String> css_keywords;
 static QMultiHash<char, QLatin1String> css_types;
 static QMultiHash<char, QLatin1String> css_literals;
@@ -2634,26 +2799,22 @@ void initCSSData() {
 
     css_other = {};
 }
-void loadCSSData(QMultiHash<char, QLatin1String> &types,
-                 QMultiHash<char, QLatin1String> &keywords,
-                 QMultiHash<char, QLatin1String> &builtin,
-                 QMultiHash<char, QLatin1String> &literals,
-                 QMultiHash<char, QLatin1String> &other) {
-    if (!cssDataInitialized) {
+const LanguageData &loadCSSData() {
+    static const LanguageData data = []() {
         initCSSData();
-        cssDataInitialized = true;
-    }
-    types = css_types;
-    keywords = css_keywords;
-    builtin = css_builtin;
-    literals = css_literals;
-    other = css_other;
+        return takeLanguageData(css_types, css_keywords, css_builtin,
+                                css_literals, css_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadCSSData)
+#endif
 
 /********************************************************/
 /***   Typescript DATA  *********************************/
 /********************************************************/
-static bool typescriptDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_TYPESCRIPT
 static QMultiHash<char, QLatin1String> typescript_keywords;
 static QMultiHash<char, QLatin1String> typescript_types;
 static QMultiHash<char, QLatin1String> typescript_literals;
@@ -2751,26 +2912,23 @@ void initTypescriptData() {
 
     typescript_other = {};
 }
-void loadTypescriptData(QMultiHash<char, QLatin1String> &types,
-                        QMultiHash<char, QLatin1String> &keywords,
-                        QMultiHash<char, QLatin1String> &builtin,
-                        QMultiHash<char, QLatin1String> &literals,
-                        QMultiHash<char, QLatin1String> &other) {
-    if (!typescriptDataInitialized) {
+const LanguageData &loadTypescriptData() {
+    static const LanguageData data = []() {
         initTypescriptData();
-        typescriptDataInitialized = true;
-    }
-    types = typescript_types;
-    keywords = typescript_keywords;
-    builtin = typescript_builtin;
-    literals = typescript_literals;
-    other = typescript_other;
+        return takeLanguageData(typescript_types, typescript_keywords,
+                                typescript_builtin, typescript_literals,
+                                typescript_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadTypescriptData)
+#endif
 
 /********************************************************/
 /***   YAML DATA  ***************************************/
 /********************************************************/
-static bool YAMLDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_YAML
 static QMultiHash<char, QLatin1String> YAML_keywords;
 static QMultiHash<char, QLatin1String> YAML_types;
 static QMultiHash<char, QLatin1String> YAML_literals;
@@ -2788,26 +2946,22 @@ void initYAMLData() {
     YAML_builtin = {};
     YAML_other = {};
 }
-void loadYAMLData(QMultiHash<char, QLatin1String> &types,
-                  QMultiHash<char, QLatin1String> &keywords,
-                  QMultiHash<char, QLatin1String> &builtin,
-                  QMultiHash<char, QLatin1String> &literals,
-                  QMultiHash<char, QLatin1String> &other) {
-    if (!YAMLDataInitialized) {
+const LanguageData &loadYAMLData() {
+    static const LanguageData data = []() {
         initYAMLData();
-        YAMLDataInitialized = true;
-    }
-    types = YAML_types;
-    keywords = YAML_keywords;
-    builtin = YAML_builtin;
-    literals = YAML_literals;
-    other = YAML_other;
+        return takeLanguageData(YAML_types, YAML_keywords, YAML_builtin,
+                                YAML_literals, YAML_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadYAMLData)
+#endif
 
 /********************************************************/
 /***   VEX DATA   ***************************************/
 /********************************************************/
-static bool vexDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_VEX
 static QMultiHash<char, QLatin1String> vex_keywords;
 static QMultiHash<char, QLatin1String> vex_types;
 static QMultiHash<char, QLatin1String> vex_literals;
@@ -3505,26 +3659,22 @@ void initVEXData() {
         {('u'), QLatin1String("undef")},
     };
 }
-void loadVEXData(QMultiHash<char, QLatin1String> &types,
-                 QMultiHash<char, QLatin1String> &keywords,
-                 QMultiHash<char, QLatin1String> &builtin,
-                 QMultiHash<char, QLatin1String> &literals,
-                 QMultiHash<char, QLatin1String> &other) {
-    if (!vexDataInitialized) {
+const LanguageData &loadVEXData() {
+    static const LanguageData data = []() {
         initVEXData();
-        vexDataInitialized = true;
-    }
-    types = vex_types;
-    keywords = vex_keywords;
-    builtin = vex_builtin;
-    literals = vex_literals;
-    other = vex_other;
+        return takeLanguageData(vex_types, vex_keywords, vex_builtin,
+                                vex_literals, vex_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadVEXData)
+#endif
 
 /********************************************************/
 /***   CMAKE DATA   ***************************************/
 /********************************************************/
-static bool cmakeDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_CMAKE
 static QMultiHash<char, QLatin1String> cmake_keywords;
 static QMultiHash<char, QLatin1String> cmake_types;
 static QMultiHash<char, QLatin1String> cmake_literals;
@@ -4111,26 +4261,22 @@ void initCMakeData() {
         {'C', QLatin1String("CPACK_WARN_ON_ABSOLUTE_INSTALL_DESTINATION")}};
 }
 
-void loadCMakeData(QMultiHash<char, QLatin1String> &types,
-                   QMultiHash<char, QLatin1String> &keywords,
-                   QMultiHash<char, QLatin1String> &builtin,
-                   QMultiHash<char, QLatin1String> &literals,
-                   QMultiHash<char, QLatin1String> &other) {
-    if (!cmakeDataInitialized) {
+const LanguageData &loadCMakeData() {
+    static const LanguageData data = []() {
         initCMakeData();
-        cmakeDataInitialized = true;
-    }
-    types = cmake_types;
-    keywords = cmake_keywords;
-    builtin = cmake_builtin;
-    literals = cmake_literals;
-    other = cmake_other;
+        return takeLanguageData(cmake_types, cmake_keywords, cmake_builtin,
+                                cmake_literals, cmake_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadCMakeData)
+#endif
 
 /********************************************************/
 /***   MAKE DATA   **************************************/
 /********************************************************/
-static bool makeDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_MAKE
 static QMultiHash<char, QLatin1String> make_keywords;
 static QMultiHash<char, QLatin1String> make_types;
 static QMultiHash<char, QLatin1String> make_literals;
@@ -4179,26 +4325,22 @@ void initMakeData() {
     };
 }
 
-void loadMakeData(QMultiHash<char, QLatin1String> &types,
-                  QMultiHash<char, QLatin1String> &keywords,
-                  QMultiHash<char, QLatin1String> &builtin,
-                  QMultiHash<char, QLatin1String> &literals,
-                  QMultiHash<char, QLatin1String> &other) {
-    if (!makeDataInitialized) {
+const LanguageData &loadMakeData() {
+    static const LanguageData data = []() {
         initMakeData();
-        makeDataInitialized = true;
-    }
-    types = make_types;
-    keywords = make_keywords;
-    builtin = make_builtin;
-    literals = make_literals;
-    other = make_other;
+        return takeLanguageData(make_types, make_keywords, make_builtin,
+                                make_literals, make_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadMakeData)
+#endif
 
 /********************************************************/
 /***   Forth DATA   *************************************/
 /********************************************************/
-static bool forthDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_FORTH
 static QMultiHash<char, QLatin1String> forth_keywords;
 static QMultiHash<char, QLatin1String> forth_types;
 static QMultiHash<char, QLatin1String> forth_builtin;
@@ -5990,27 +6132,23 @@ void initForthData() {
 
     forth_other = {};
 }
-void loadForthData(QMultiHash<char, QLatin1String> &types,
-                   QMultiHash<char, QLatin1String> &keywords,
-                   QMultiHash<char, QLatin1String> &builtin,
-                   QMultiHash<char, QLatin1String> &literals,
-                   QMultiHash<char, QLatin1String> &other) {
-    if (!forthDataInitialized) {
+const LanguageData &loadForthData() {
+    static const LanguageData data = []() {
         initForthData();
-        forthDataInitialized = true;
-    }
-    types = forth_types;
-    keywords = forth_keywords;
-    builtin = forth_builtin;
-    literals = forth_literals;
-    other = forth_other;
+        return takeLanguageData(forth_types, forth_keywords, forth_builtin,
+                                forth_literals, forth_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadForthData)
+#endif
 
 /**********************************************************/
 /* GDScript Data *********************************************/
 /**********************************************************/
 
-static bool gdscriptDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_GDSCRIPT
 static QMultiHash<char, QLatin1String> gdscript_keywords;
 static QMultiHash<char, QLatin1String> gdscript_types;
 static QMultiHash<char, QLatin1String> gdscript_literals;
@@ -7249,26 +7387,23 @@ void initGDScriptData() {
         {('w'), QLatin1String("warning_ignore")},
     };
 }
-void loadGDScriptData(QMultiHash<char, QLatin1String> &types,
-                      QMultiHash<char, QLatin1String> &keywords,
-                      QMultiHash<char, QLatin1String> &builtin,
-                      QMultiHash<char, QLatin1String> &literals,
-                      QMultiHash<char, QLatin1String> &other) {
-    if (!gdscriptDataInitialized) {
+const LanguageData &loadGDScriptData() {
+    static const LanguageData data = []() {
         initGDScriptData();
-        gdscriptDataInitialized = true;
-    }
-    types = gdscript_types;
-    keywords = gdscript_keywords;
-    builtin = gdscript_builtin;
-    literals = gdscript_literals;
-    other = gdscript_other;
+        return takeLanguageData(gdscript_types, gdscript_keywords,
+                                gdscript_builtin, gdscript_literals,
+                                gdscript_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadGDScriptData)
+#endif
 
 /********************************************************/
 /***   TOML DATA  ***************************************/
 /********************************************************/
-static bool TOMLDataInitialized = false;
+#ifndef QMARKDOWNTEXTEDIT_EXCLUDE_TOML
 static QMultiHash<char, QLatin1String> TOML_keywords;
 static QMultiHash<char, QLatin1String> TOML_types;
 static QMultiHash<char, QLatin1String> TOML_literals;
@@ -7286,18 +7421,14 @@ void initTOMLData() {
     TOML_builtin = {};
     TOML_other = {};
 }
-void loadTOMLData(QMultiHash<char, QLatin1String> &types,
-                  QMultiHash<char, QLatin1String> &keywords,
-                  QMultiHash<char, QLatin1String> &builtin,
-                  QMultiHash<char, QLatin1String> &literals,
-                  QMultiHash<char, QLatin1String> &other) {
-    if (!TOMLDataInitialized) {
+const LanguageData &loadTOMLData() {
+    static const LanguageData data = []() {
         initTOMLData();
-        TOMLDataInitialized = true;
-    }
-    types = TOML_types;
-    keywords = TOML_keywords;
-    builtin = TOML_builtin;
-    literals = TOML_literals;
-    other = TOML_other;
+        return takeLanguageData(TOML_types, TOML_keywords, TOML_builtin,
+                                TOML_literals, TOML_other);
+    }();
+    return data;
 }
+#else
+QMARKDOWNTEXTEDIT_EXCLUDED_LANGUAGE(loadTOMLData)
+#endif
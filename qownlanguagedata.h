@@ -25,12 +25,70 @@
 #define QOWNLANGUAGEDATA_H
 
 #include <QMultiHash>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Read-only word table of a language
+ *
+ * It is built once from the language's keyword hashes and then referenced
+ * directly by the highlighter. The words are kept in sorted vectors, so
+ * looking up an identifier is a single binary search and highlighting a line
+ * doesn't copy or allocate anything.
+ *
+ * Words that contain other characters than letters, numbers and '_' (e.g.
+ * "write-line" in Forth) can't be found by looking at the identifier under the
+ * cursor, they are kept in a separate list and matched by prefix.
+ */
+class LanguageData {
+   public:
+    enum WordType : quint8 {
+        NoWord = 0,
+        // sorted by priority, to be compatible with the old lookup order
+        Type,
+        Keyword,
+        Literal,
+        Builtin,
+        Other
+    };
+
+    LanguageData(const QMultiHash<char, QLatin1String> &types,
+                 const QMultiHash<char, QLatin1String> &keywords,
+                 const QMultiHash<char, QLatin1String> &builtin,
+                 const QMultiHash<char, QLatin1String> &literals,
+                 const QMultiHash<char, QLatin1String> &other);
+
+    /**
+     * Matches a type, keyword, literal or builtin word at `pos`
+     * `pos` needs to be the start of a word
+     * @return the length of the matched word or 0, `type` is set to the
+     * WordType of the match
+     */
+    int matchWord(const QString &text, int pos, WordType &type) const;
+
+    /**
+     * Matches an "other" word (e.g. preprocessor) at `pos`
+     * @return the length of the matched word or 0
+     */
+    int matchOther(const QString &text, int pos) const;
+
+    struct Entry {
+        QLatin1String word;
+        WordType type;
+    };
+
+   private:
+    QVector<Entry> _words;
+    QVector<Entry> _irregularWords;
+    QVector<Entry> _otherWords;
+    QVector<Entry> _irregularOtherWords;
+};
 
 /* ------------------------
  * TEMPLATE FOR LANG DATA
  * -------------------------
  *
- * loadXXXData, where XXX is the language
+ * loadXXXData, where XXX is the language, returns its LanguageData
  * keywords are the language keywords e.g, const
  * types are built-in types i.e, int, char, var
  * literals are words like, true false
@@ -58,213 +116,117 @@
 /**********************************************************/
 /* C/C++ Data *********************************************/
 /**********************************************************/
-void loadCppData(QMultiHash<char, QLatin1String> &typess,
-                 QMultiHash<char, QLatin1String> &keywordss,
-                 QMultiHash<char, QLatin1String> &builtins,
-                 QMultiHash<char, QLatin1String> &literalss,
-                 QMultiHash<char, QLatin1String> &others);
+const LanguageData &loadCppData();
 
 /**********************************************************/
 /* Shell Data *********************************************/
 /**********************************************************/
-void loadShellData(QMultiHash<char, QLatin1String> &types,
-                   QMultiHash<char, QLatin1String> &keywords,
-                   QMultiHash<char, QLatin1String> &builtin,
-                   QMultiHash<char, QLatin1String> &literals,
-                   QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadShellData();
 
 /**********************************************************/
 /* JS Data *********************************************/
 /**********************************************************/
-void loadJSData(QMultiHash<char, QLatin1String> &types,
-                QMultiHash<char, QLatin1String> &keywords,
-                QMultiHash<char, QLatin1String> &builtin,
-                QMultiHash<char, QLatin1String> &literals,
-                QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadJSData();
 
 /**********************************************************/
 /* JS Data *********************************************/
 /**********************************************************/
-void loadNixData(QMultiHash<char, QLatin1String> &types,
-                 QMultiHash<char, QLatin1String> &keywords,
-                 QMultiHash<char, QLatin1String> &builtin,
-                 QMultiHash<char, QLatin1String> &literals,
-                 QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadNixData();
 
 /**********************************************************/
 /* PHP Data *********************************************/
 /**********************************************************/
-void loadPHPData(QMultiHash<char, QLatin1String> &types,
-                 QMultiHash<char, QLatin1String> &keywords,
-                 QMultiHash<char, QLatin1String> &builtin,
-                 QMultiHash<char, QLatin1String> &literals,
-                 QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadPHPData();
 
 /**********************************************************/
 /* QML Data *********************************************/
 /**********************************************************/
-void loadQMLData(QMultiHash<char, QLatin1String> &types,
-                 QMultiHash<char, QLatin1String> &keywords,
-                 QMultiHash<char, QLatin1String> &builtin,
-                 QMultiHash<char, QLatin1String> &literals,
-                 QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadQMLData();
 
 /**********************************************************/
 /* Python Data *********************************************/
 /**********************************************************/
-void loadPythonData(QMultiHash<char, QLatin1String> &types,
-                    QMultiHash<char, QLatin1String> &keywords,
-                    QMultiHash<char, QLatin1String> &builtin,
-                    QMultiHash<char, QLatin1String> &literals,
-                    QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadPythonData();
 
 /********************************************************/
 /***   Rust DATA      ***********************************/
 /********************************************************/
-void loadRustData(QMultiHash<char, QLatin1String> &types,
-                  QMultiHash<char, QLatin1String> &keywords,
-                  QMultiHash<char, QLatin1String> &builtin,
-                  QMultiHash<char, QLatin1String> &literals,
-                  QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadRustData();
 
 /********************************************************/
 /***   Java DATA      ***********************************/
 /********************************************************/
-void loadJavaData(QMultiHash<char, QLatin1String> &types,
-                  QMultiHash<char, QLatin1String> &keywords,
-                  QMultiHash<char, QLatin1String> &builtin,
-                  QMultiHash<char, QLatin1String> &literals,
-                  QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadJavaData();
 
 /********************************************************/
 /***   C# DATA      *************************************/
 /********************************************************/
-void loadCSharpData(QMultiHash<char, QLatin1String> &types,
-                    QMultiHash<char, QLatin1String> &keywords,
-                    QMultiHash<char, QLatin1String> &builtin,
-                    QMultiHash<char, QLatin1String> &literals,
-                    QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadCSharpData();
 
 /********************************************************/
 /***   Go DATA      *************************************/
 /********************************************************/
-void loadGoData(QMultiHash<char, QLatin1String> &types,
-                QMultiHash<char, QLatin1String> &keywords,
-                QMultiHash<char, QLatin1String> &builtin,
-                QMultiHash<char, QLatin1String> &literals,
-                QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadGoData();
 
 /********************************************************/
 /***   V DATA      **************************************/
 /********************************************************/
-void loadVData(QMultiHash<char, QLatin1String> &types,
-               QMultiHash<char, QLatin1String> &keywords,
-               QMultiHash<char, QLatin1String> &builtin,
-               QMultiHash<char, QLatin1String> &literals,
-               QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadVData();
 
 /********************************************************/
 /***   SQL DATA      ************************************/
 /********************************************************/
-void loadSQLData(QMultiHash<char, QLatin1String> &types,
-                 QMultiHash<char, QLatin1String> &keywords,
-                 QMultiHash<char, QLatin1String> &builtin,
-                 QMultiHash<char, QLatin1String> &literals,
-                 QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadSQLData();
 
 /********************************************************/
 /***   System Verilog DATA      *************************/
 /********************************************************/
-void loadSystemVerilogData(QMultiHash<char, QLatin1String> &types,
-                           QMultiHash<char, QLatin1String> &keywords,
-                           QMultiHash<char, QLatin1String> &builtin,
-                           QMultiHash<char, QLatin1String> &literals,
-                           QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadSystemVerilogData();
 
 /********************************************************/
 /***   JSON DATA      ***********************************/
 /********************************************************/
-void loadJSONData(QMultiHash<char, QLatin1String> &types,
-                  QMultiHash<char, QLatin1String> &keywords,
-                  QMultiHash<char, QLatin1String> &builtin,
-                  QMultiHash<char, QLatin1String> &literals,
-                  QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadJSONData();
 
 /********************************************************/
 /***   CSS DATA      ***********************************/
 /********************************************************/
-void loadCSSData(QMultiHash<char, QLatin1String> &types,
-                 QMultiHash<char, QLatin1String> &keywords,
-                 QMultiHash<char, QLatin1String> &builtin,
-                 QMultiHash<char, QLatin1String> &literals,
-                 QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadCSSData();
 
 /********************************************************/
 /***   Typescript DATA  *********************************/
 /********************************************************/
-void loadTypescriptData(QMultiHash<char, QLatin1String> &types,
-                        QMultiHash<char, QLatin1String> &keywords,
-                        QMultiHash<char, QLatin1String> &builtin,
-                        QMultiHash<char, QLatin1String> &literals,
-                        QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadTypescriptData();
 
 /********************************************************/
 /***   YAML DATA  ***************************************/
 /********************************************************/
-void loadYAMLData(QMultiHash<char, QLatin1String> &types,
-                  QMultiHash<char, QLatin1String> &keywords,
-                  QMultiHash<char, QLatin1String> &builtin,
-                  QMultiHash<char, QLatin1String> &literals,
-                  QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadYAMLData();
 
 /********************************************************/
 /***   VEX DATA  ****************************************/
 /********************************************************/
-void loadVEXData(QMultiHash<char, QLatin1String> &types,
-                 QMultiHash<char, QLatin1String> &keywords,
-                 QMultiHash<char, QLatin1String> &builtin,
-                 QMultiHash<char, QLatin1String> &literals,
-                 QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadVEXData();
 
 /********************************************************/
 /***   CMake DATA  **************************************/
 /********************************************************/
-void loadCMakeData(QMultiHash<char, QLatin1String> &types,
-                   QMultiHash<char, QLatin1String> &keywords,
-                   QMultiHash<char, QLatin1String> &builtin,
-                   QMultiHash<char, QLatin1String> &literals,
-                   QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadCMakeData();
 
 /********************************************************/
 /***   Make DATA  ***************************************/
 /********************************************************/
-void loadMakeData(QMultiHash<char, QLatin1String> &types,
-                  QMultiHash<char, QLatin1String> &keywords,
-                  QMultiHash<char, QLatin1String> &builtin,
-                  QMultiHash<char, QLatin1String> &literals,
-                  QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadMakeData();
 /********************************************************/
 /***   Forth DATA  **************************************/
 /********************************************************/
-void loadForthData(QMultiHash<char, QLatin1String> &types,
-                   QMultiHash<char, QLatin1String> &keywords,
-                   QMultiHash<char, QLatin1String> &builtin,
-                   QMultiHash<char, QLatin1String> &literals,
-                   QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadForthData();
 /********************************************************/
 /***   GDScript DATA  **************************************/
 /********************************************************/
-void loadGDScriptData(QMultiHash<char, QLatin1String> &types,
-                      QMultiHash<char, QLatin1String> &keywords,
-                      QMultiHash<char, QLatin1String> &builtin,
-                      QMultiHash<char, QLatin1String> &literals,
-                      QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadGDScriptData();
 /********************************************************/
 /***   TOML DATA  **************************************/
 /********************************************************/
-void loadTOMLData(QMultiHash<char, QLatin1String> &types,
-                  QMultiHash<char, QLatin1String> &keywords,
-                  QMultiHash<char, QLatin1String> &builtin,
-                  QMultiHash<char, QLatin1String> &literals,
-                  QMultiHash<char, QLatin1String> &other);
+const LanguageData &loadTOMLData();
 #endif
@@ -25,11 +25,19 @@
 #include "qplaintexteditsearchwidget.h"
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QEvent>
 #include <QKeyEvent>
+#include <QScrollBar>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <algorithm>
 
 #include "ui_qplaintexteditsearchwidget.h"
 
+// milliseconds spent searching the document per event loop iteration
+static const int searchScanBudget = 10;
+
 QPlainTextEditSearchWidget::QPlainTextEditSearchWidget(QPlainTextEdit *parent)
     : QWidget(parent),
       ui(new Ui::QPlainTextEditSearchWidget),
@@ -62,6 +70,19 @@ QPlainTextEditSearchWidget::QPlainTextEditSearchWidget(QPlainTextEdit *parent)
     connect(&_debounceTimer, &QTimer::timeout, this,
             &QPlainTextEditSearchWidget::performSearch);
 
+    _searchScanTimer.setSingleShot(true);
+    _searchScanTimer.setInterval(0);
+    connect(&_searchScanTimer, &QTimer::timeout, this,
+            &QPlainTextEditSearchWidget::continueSearchScan);
+
+    // keep the search matches up to date while the text is edited
+    watchSearchDocument();
+
+    // only the matches in the viewport get extra selections
+    connect(_textEdit->verticalScrollBar(), &QScrollBar::valueChanged, this,
+            &QPlainTextEditSearchWidget::updateVisibleSearchExtraSelections);
+    _textEdit->viewport()->installEventFilter(this);
+
     installEventFilter(this);
     ui->searchLineEdit->installEventFilter(this);
     ui->replaceLineEdit->installEventFilter(this);
@@ -99,6 +120,7 @@ void QPlainTextEditSearchWidget::activateReplace() {
 
 void QPlainTextEditSearchWidget::deactivate() {
     stopDebounce();
+    cancelSearchScan();
 
     hide();
 
@@ -118,6 +140,14 @@ void QPlainTextEditSearchWidget::setReplaceMode(bool enabled) {
 }
 
 bool QPlainTextEditSearchWidget::eventFilter(QObject *obj, QEvent *event) {
+    if (obj == _textEdit->viewport()) {
+        if (event->type() == QEvent::Resize) {
+            updateVisibleSearchExtraSelections();
+        }
+
+        return false;
+    }
+
     if (event->type() == QEvent::KeyPress) {
         auto *keyEvent = static_cast<QKeyEvent *>(event);
 
@@ -157,6 +187,9 @@ void QPlainTextEditSearchWidget::searchLineEditTextChanged(
     const QString &arg1) {
     _searchTerm = arg1;
 
+    // the search of the previous text isn't needed anymore
+    cancelSearchScan();
+
     if (_debounceTimer.interval() != 0 && !_searchTerm.isEmpty()) {
         _debounceTimer.start();
         ui->searchDownButton->setEnabled(false);
@@ -173,38 +206,98 @@ void QPlainTextEditSearchWidget::performSearch() {
 }
 
 void QPlainTextEditSearchWidget::clearSearchExtraSelections() {
+    _showSearchExtraSelections = false;
     _searchExtraSelections.clear();
     setSearchExtraSelections();
 }
 
 void QPlainTextEditSearchWidget::updateSearchExtraSelections() {
+    _showSearchExtraSelections = true;
     _searchExtraSelections.clear();
-    const auto textCursor = _textEdit->textCursor();
-    _textEdit->moveCursor(QTextCursor::Start);
+    updateSearchMatches();
+
+    if (_visibleSearchExtraSelectionsOnly) {
+        updateVisibleSearchExtraSelections();
+        return;
+    }
+
     const QColor color = selectionColor;
     QTextCharFormat extraFmt;
     extraFmt.setBackground(color);
-    int findCounter = 0;
-    const int searchMode = ui->modeComboBox->currentIndex();
+    QTextCursor cursor(_textEdit->document());
+    _searchExtraSelections.reserve(_searchMatches.size());
 
-    while (doSearch(true, false, false)) {
-        findCounter++;
+    for (const SearchMatch &match : _searchMatches) {
+        QTextEdit::ExtraSelection extra = QTextEdit::ExtraSelection();
+        extra.format = extraFmt;
 
-        // prevent infinite loops from regular expression searches like "$", "^"
-        // or "\b"
-        if (searchMode == RegularExpressionMode && findCounter >= 10000) {
-            break;
-        }
+        cursor.setPosition(match.position);
+        cursor.setPosition(match.position + match.length,
+                           QTextCursor::KeepAnchor);
+        extra.cursor = cursor;
+        _searchExtraSelections.append(extra);
+    }
+
+    this->setSearchExtraSelections();
+}
+
+/**
+ * @brief Creates the extra selections for the search matches in the viewport
+ * of the text edit, so scrolling and painting doesn't depend on the number
+ * of all matches
+ */
+void QPlainTextEditSearchWidget::updateVisibleSearchExtraSelections() {
+    if (!_showSearchExtraSelections || !_visibleSearchExtraSelectionsOnly) {
+        return;
+    }
+
+    updateSearchMatches();
+    _searchExtraSelections.clear();
+
+    const QRect rect = _textEdit->viewport()->rect();
+    const QTextBlock firstBlock =
+        _textEdit->cursorForPosition(rect.topLeft()).block();
+    const QTextBlock lastBlock =
+        _textEdit->cursorForPosition(rect.bottomRight()).block();
+    const int from = firstBlock.position();
+    const int to = lastBlock.position() + lastBlock.length();
+
+    QTextCharFormat extraFmt;
+    extraFmt.setBackground(selectionColor);
+    QTextCursor cursor(_textEdit->document());
+
+    for (int i = findSearchMatch(from, true);
+         i != -1 && i < _searchMatches.size(); ++i) {
+        const SearchMatch &match = _searchMatches.at(i);
+        if (match.position >= to) break;
 
         QTextEdit::ExtraSelection extra = QTextEdit::ExtraSelection();
         extra.format = extraFmt;
 
-        extra.cursor = _textEdit->textCursor();
+        cursor.setPosition(match.position);
+        cursor.setPosition(match.position + match.length,
+                           QTextCursor::KeepAnchor);
+        extra.cursor = cursor;
         _searchExtraSelections.append(extra);
     }
 
-    _textEdit->setTextCursor(textCursor);
-    this->setSearchExtraSelections();
+    setSearchExtraSelections();
+}
+
+/**
+ * @brief Sets if only the search matches in the viewport get extra
+ * selections (default), instead of the matches in the whole document
+ * @param enabled
+ */
+void QPlainTextEditSearchWidget::setVisibleSearchExtraSelectionsOnly(
+    bool enabled) {
+    if (_visibleSearchExtraSelectionsOnly == enabled) return;
+
+    _visibleSearchExtraSelectionsOnly = enabled;
+
+    if (_showSearchExtraSelections) {
+        updateSearchExtraSelections();
+    }
 }
 
 void QPlainTextEditSearchWidget::setSearchExtraSelections() const {
@@ -260,14 +353,406 @@ void QPlainTextEditSearchWidget::doReplaceAll() {
         return;
     }
 
-    // start at the top
-    _textEdit->moveCursor(QTextCursor::Start);
+    completeSearch();
+    const QVector<SearchMatch> matches = _searchMatches;
+    if (matches.isEmpty()) return;
+
+    const QString replaceText = ui->replaceLineEdit->text();
+    QTextDocument *document = _textEdit->document();
+    QTextCursor cursor(document);
+
+    // replace from the bottom to the top, so the positions of the remaining
+    // matches stay valid, in one edit block that is undone at once, and the
+    // document only notifies the highlighter and the layout once at its end
+    cursor.beginEditBlock();
+
+    int end = matches.size();
+    while (end > 0) {
+        // the matches of a block are replaced with a single insertion
+        const QTextBlock block =
+            document->findBlock(matches.at(end - 1).position);
+        const int blockPosition = block.position();
+        int begin = end - 1;
+        while (begin > 0 && matches.at(begin - 1).position >= blockPosition) {
+            --begin;
+        }
+
+        const QString text = block.text();
+        const int from = matches.at(begin).position - blockPosition;
+        const int to = matches.at(end - 1).position +
+                       matches.at(end - 1).length - blockPosition;
+        QString replacement;
+        int offset = from;
+
+        for (int i = begin; i < end; ++i) {
+            const int start = matches.at(i).position - blockPosition;
+            replacement.append(text.constData() + offset, start - offset);
+
+            if (_searchMatchesMode == RegularExpressionMode) {
+                QString matchedText = text.mid(start, matches.at(i).length);
+                matchedText.replace(_searchRegExp, replaceText);
+                replacement += matchedText;
+            } else {
+                replacement += replaceText;
+            }
+
+            offset = start + matches.at(i).length;
+        }
+
+        cursor.setPosition(blockPosition + from);
+        cursor.setPosition(blockPosition + to, QTextCursor::KeepAnchor);
+        cursor.insertText(replacement);
+        end = begin;
+    }
+
+    cursor.endEditBlock();
+}
+
+/**
+ * @brief Compiles the search pattern and starts searching all its matches in
+ * the document in one pass, if the search or the text changed
+ *
+ * The first blocks are searched right away, the rest of them in time slices
+ * in the next event loop iterations, so searching a large document doesn't
+ * block the editor.
+ */
+void QPlainTextEditSearchWidget::updateSearchMatches() {
+    watchSearchDocument();
+
+    const QString text = ui->searchLineEdit->text();
+    const int searchMode = ui->modeComboBox->currentIndex();
+    const bool caseSensitive = ui->matchCaseSensitiveButton->isChecked();
+
+    if (!_searchMatchesDirty && text == _searchMatchesText &&
+        searchMode == _searchMatchesMode &&
+        caseSensitive == _searchMatchesCaseSensitive) {
+        return;
+    }
+
+    _searchMatchesDirty = false;
+    _searchMatchesText = text;
+    _searchMatchesMode = searchMode;
+    _searchMatchesCaseSensitive = caseSensitive;
+    _searchMatches.clear();
+    _searchScanTimer.stop();
+    _searchScanPosition = -1;
+
+    if (searchMode == RegularExpressionMode) {
+        _searchRegExp = QRegularExpression(
+            text, caseSensitive ? QRegularExpression::NoPatternOption
+                                : QRegularExpression::CaseInsensitiveOption);
+        _searchRegExp.optimize();
+    } else {
+        _searchMatcher = QStringMatcher(
+            text, caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    }
+
+    if (text.isEmpty() ||
+        (searchMode == RegularExpressionMode && !_searchRegExp.isValid())) {
+        _searchResultCount = 0;
+        return;
+    }
+
+    _searchScanPosition = 0;
+    scanSearchMatches(searchScanBudget);
+}
+
+/**
+ * @brief Searches the next blocks of the document for matches, like
+ * QTextDocument::find() matches never span multiple blocks
+ * @param budget milliseconds to search, -1 for no limit
+ * @param untilPosition stops as soon as a match at or after the position was
+ * found, so all matches before it are known, -1 searches all blocks
+ */
+void QPlainTextEditSearchWidget::scanSearchMatches(int budget,
+                                                   int untilPosition) {
+    if (_searchScanPosition == -1) return;
+
+    QElapsedTimer timer;
+    timer.start();
+    QTextBlock block = _textEdit->document()->findBlock(_searchScanPosition);
+
+    while (block.isValid()) {
+        if (untilPosition != -1 && !_searchMatches.isEmpty() &&
+            _searchMatches.at(_searchMatches.size() - 1).position >=
+                untilPosition) {
+            break;
+        }
+
+        if (budget != -1 && timer.elapsed() >= budget) break;
+
+        findSearchMatches(block.text(), block.position(), _searchMatches);
+        block = block.next();
+    }
+
+    _searchScanPosition = block.isValid() ? block.position() : -1;
+    _searchResultCount = _searchMatches.size();
+
+    if (_searchScanPosition == -1) {
+        _searchScanTimer.stop();
+    } else if (!_searchScanTimer.isActive()) {
+        _searchScanTimer.start();
+    }
+}
+
+/**
+ * @brief Searches the next time slice and shows the matches found so far,
+ * the count is shown as lower bound until the search is complete
+ */
+void QPlainTextEditSearchWidget::continueSearchScan() {
+    if (_searchScanPosition == -1 || _searchMatchesDirty) return;
+
+    scanSearchMatches(searchScanBudget);
+
+    if (_visibleSearchExtraSelectionsOnly) {
+        updateVisibleSearchExtraSelections();
+    } else if (_showSearchExtraSelections && _searchScanPosition == -1) {
+        updateSearchExtraSelections();
+    }
+
+    updateSearchCountLabelText();
+}
+
+/**
+ * @brief Stops searching the document, the search starts over the next time
+ * the matches are needed
+ */
+void QPlainTextEditSearchWidget::cancelSearchScan() {
+    if (_searchScanPosition == -1) return;
+
+    _searchScanTimer.stop();
+    _searchScanPosition = -1;
+    _searchMatchesDirty = true;
+}
+
+/**
+ * @brief Searches the rest of the document right away, like before all
+ * matches are needed
+ */
+void QPlainTextEditSearchWidget::completeSearch() {
+    updateSearchMatches();
+    if (_searchScanPosition == -1) return;
+
+    scanSearchMatches(-1);
+
+    if (_showSearchExtraSelections) {
+        if (_visibleSearchExtraSelectionsOnly) {
+            updateVisibleSearchExtraSelections();
+        } else {
+            updateSearchExtraSelections();
+        }
+    }
+
+    updateSearchCountLabelText();
+}
+
+/**
+ * @brief Follows the changes of the document of the text edit, it might be
+ * replaced with setDocument()
+ */
+void QPlainTextEditSearchWidget::watchSearchDocument() {
+    QTextDocument *document = _textEdit->document();
+    if (document == _searchDocument) return;
+
+    disconnect(_searchDocumentConnection);
+    _searchDocument = document;
+    _searchDocumentConnection =
+        connect(document, &QTextDocument::contentsChange, this,
+                &QPlainTextEditSearchWidget::updateSearchMatchesAfterChange);
+    _searchMatchesDirty = true;
+}
+
+/**
+ * @brief Searches the blocks of a document change again and moves the
+ * matches behind them, so the costs depend on the size of the change and not
+ * of the document
+ * @param position
+ * @param charsRemoved
+ * @param charsAdded
+ */
+void QPlainTextEditSearchWidget::updateSearchMatchesAfterChange(
+    int position, int charsRemoved, int charsAdded) {
+    if (_searchMatchesDirty) return;
+
+    // there is no need to keep the matches up to date while not searching
+    if (!isVisible() || _searchMatchesText.isEmpty()) {
+        cancelSearchScan();
+        _searchMatchesDirty = true;
+        return;
+    }
+
+    // the search is started again, if it wasn't complete yet
+    if (_searchScanPosition != -1) {
+        _searchMatchesDirty = true;
+        updateSearchMatches();
+        updateVisibleSearchExtraSelections();
+        updateSearchCountLabelText();
+        return;
+    }
+
+    // matches never span multiple blocks, so only the blocks of the change
+    // need to be searched again
+    const QTextBlock firstBlock = _searchDocument->findBlock(position);
+    QTextBlock lastBlock = _searchDocument->findBlock(position + charsAdded);
+    if (!lastBlock.isValid()) lastBlock = _searchDocument->lastBlock();
+
+    if (!firstBlock.isValid()) {
+        _searchMatchesDirty = true;
+        return;
+    }
+
+    const int delta = charsAdded - charsRemoved;
+    const int from = firstBlock.position();
+    const int to = lastBlock.position() + lastBlock.length();
+
+    QVector<SearchMatch> matches;
+    for (QTextBlock block = firstBlock; block.isValid(); block = block.next()) {
+        findSearchMatches(block.text(), block.position(), matches);
+        if (block == lastBlock) break;
+    }
+
+    // replace the matches of the changed blocks (positions before the change)
+    const auto byPosition = [](const SearchMatch &match, int pos) {
+        return match.position < pos;
+    };
+    const int begin = int(std::lower_bound(_searchMatches.cbegin(),
+                                           _searchMatches.cend(), from,
+                                           byPosition) -
+                          _searchMatches.cbegin());
+    const int end = int(std::lower_bound(_searchMatches.cbegin() + begin,
+                                         _searchMatches.cend(), to - delta,
+                                         byPosition) -
+                        _searchMatches.cbegin());
+
+    const bool sameCount = matches.size() == end - begin;
+
+    // nothing changed for the search, e.g. only the formats were changed by
+    // the highlighter
+    if (delta == 0 && sameCount &&
+        std::equal(matches.cbegin(), matches.cend(),
+                   _searchMatches.cbegin() + begin,
+                   [](const SearchMatch &a, const SearchMatch &b) {
+                       return a.position == b.position && a.length == b.length;
+                   })) {
+        return;
+    }
+
+    // the extra selections are only spliced if they belong to all matches
+    const bool updateExtraSelections =
+        !_visibleSearchExtraSelectionsOnly &&
+        !_searchExtraSelections.isEmpty() &&
+        _searchExtraSelections.size() == _searchMatches.size();
+
+    for (int i = end; i < _searchMatches.size(); ++i) {
+        _searchMatches[i].position += delta;
+    }
+
+    if (sameCount) {
+        std::copy(matches.cbegin(), matches.cend(),
+                  _searchMatches.begin() + begin);
+    } else {
+        _searchMatches = _searchMatches.mid(0, begin) + matches +
+                         _searchMatches.mid(end);
+    }
+
+    _searchResultCount = _searchMatches.size();
+    _currentSearchResult = qMin(_currentSearchResult, _searchResultCount);
+
+    // the cursors of the extra selections already moved with the text
+    if (updateExtraSelections) {
+        QTextCharFormat extraFmt;
+        extraFmt.setBackground(selectionColor);
+        QList<QTextEdit::ExtraSelection> extraSelections;
+
+        for (const SearchMatch &match : matches) {
+            QTextEdit::ExtraSelection extra = QTextEdit::ExtraSelection();
+            extra.format = extraFmt;
+            extra.cursor = QTextCursor(_searchDocument);
+            extra.cursor.setPosition(match.position);
+            extra.cursor.setPosition(match.position + match.length,
+                                     QTextCursor::KeepAnchor);
+            extraSelections.append(extra);
+        }
+
+        _searchExtraSelections = _searchExtraSelections.mid(0, begin) +
+                                 extraSelections +
+                                 _searchExtraSelections.mid(end);
+        setSearchExtraSelections();
+    } else {
+        updateVisibleSearchExtraSelections();
+    }
+
+    updateSearchCountLabelText();
+}
+
+/**
+ * @brief Appends the matches of the compiled search pattern in the text of a
+ * block
+ * @param text
+ * @param position position of the block in the document
+ * @param matches
+ */
+void QPlainTextEditSearchWidget::findSearchMatches(
+    const QString &text, int position, QVector<SearchMatch> &matches) const {
+    if (_searchMatchesMode == RegularExpressionMode) {
+        int offset = 0;
+
+        while (offset <= text.length()) {
+            const QRegularExpressionMatch match =
+                _searchRegExp.match(text, offset);
+            if (!match.hasMatch()) break;
+
+            const int start = match.capturedStart();
+            const int length = match.capturedLength();
+            matches.append({position + start, length});
+
+            // prevent infinite loops from regular expression searches like
+            // "$", "^" or "\b"
+            offset = start + qMax(length, 1);
+        }
+
+        return;
+    }
+
+    const int length = _searchMatchesText.length();
+    int index = _searchMatcher.indexIn(text);
+
+    while (index != -1) {
+        // same rules as QTextDocument::FindWholeWords
+        if (_searchMatchesMode == WholeWordsMode &&
+            ((index > 0 && text.at(index - 1).isLetterOrNumber()) ||
+             (index + length < text.length() &&
+              text.at(index + length).isLetterOrNumber()))) {
+            index = _searchMatcher.indexIn(text, index + 1);
+            continue;
+        }
 
-    // replace until everything to the bottom is replaced
-    while (doSearch(true, false) && doReplace(true)) {
+        matches.append({position + index, length});
+        index = _searchMatcher.indexIn(text, index + length);
     }
 }
 
+/**
+ * @brief Returns the index of the next search match from a position
+ * @param position
+ * @param searchDown
+ * @return index in _searchMatches or -1 if there is none
+ */
+int QPlainTextEditSearchWidget::findSearchMatch(int position,
+                                                bool searchDown) const {
+    // first match starting at or after the position
+    const auto it = std::lower_bound(
+        _searchMatches.cbegin(), _searchMatches.cend(), position,
+        [](const SearchMatch &match, int pos) { return match.position < pos; });
+    const int index = int(it - _searchMatches.cbegin());
+
+    if (searchDown) {
+        return index < _searchMatches.size() ? index : -1;
+    }
+
+    return index - 1;
+}
+
 /**
  * @brief Searches for text in the text edit
  * @returns true if found
@@ -289,79 +774,37 @@ bool QPlainTextEditSearchWidget::doSearch(bool searchDown,
         return false;
     }
 
-    const int searchMode = ui->modeComboBox->currentIndex();
-    const bool caseSensitive = ui->matchCaseSensitiveButton->isChecked();
+    updateSearchMatches();
 
-    QFlags<QTextDocument::FindFlag> options =
-        searchDown ? QTextDocument::FindFlag(0) : QTextDocument::FindBackward;
-    if (searchMode == WholeWordsMode) {
-        options |= QTextDocument::FindWholeWords;
-    }
+    const QTextCursor cursor = _textEdit->textCursor();
+    int position =
+        searchDown ? cursor.selectionEnd() : cursor.selectionStart();
 
-    if (caseSensitive) {
-        options |= QTextDocument::FindCaseSensitively;
+    // after the search was changed the search starts at the top
+    if (_searchFromTop) {
+        _searchFromTop = false;
+        position = 0;
     }
 
-    // block signal to reduce too many signals being fired and too many updates
-    _textEdit->blockSignals(true);
-
-    bool found =
-        searchMode == RegularExpressionMode
-            ?
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 13, 0))
-            _textEdit->find(
-                QRegularExpression(
-                    text, caseSensitive
-                              ? QRegularExpression::NoPatternOption
-                              : QRegularExpression::CaseInsensitiveOption),
-                options)
-            :
-#else
-            _textEdit->find(QRegExp(text, caseSensitive ? Qt::CaseSensitive
-                                                        : Qt::CaseInsensitive),
-                            options)
-            :
-#endif
-            _textEdit->find(text, options);
-
-    _textEdit->blockSignals(false);
+    // only the matches up to the next one after the position are needed
+    scanSearchMatches(-1, position);
+    int index = findSearchMatch(position, searchDown);
 
-    if (found) {
-        const int result =
-            searchDown ? ++_currentSearchResult : --_currentSearchResult;
-        _currentSearchResult = std::min(result, _searchResultCount);
+    // start at the top (or bottom) if not found
+    if (index == -1 && allowRestartAtTop) {
+        if (!searchDown) scanSearchMatches(-1);
 
-        updateSearchCountLabelText();
+        if (!_searchMatches.isEmpty()) {
+            index = searchDown ? 0 : _searchMatches.size() - 1;
+        }
     }
 
-    // start at the top (or bottom) if not found
-    if (!found && allowRestartAtTop) {
-        _textEdit->moveCursor(searchDown ? QTextCursor::Start
-                                         : QTextCursor::End);
-        found =
-            searchMode == RegularExpressionMode
-                ?
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 13, 0))
-                _textEdit->find(
-                    QRegularExpression(
-                        text, caseSensitive
-                                  ? QRegularExpression::NoPatternOption
-                                  : QRegularExpression::CaseInsensitiveOption),
-                    options)
-                :
-#else
-                _textEdit->find(
-                    QRegExp(text, caseSensitive ? Qt::CaseSensitive
-                                                : Qt::CaseInsensitive),
-                    options)
-                :
-#endif
-                _textEdit->find(text, options);
+    const bool found = index != -1;
 
-        if (found && updateUI) {
-            _currentSearchResult = searchDown ? 1 : _searchResultCount;
-            updateSearchCountLabelText();
-        }
+    if (found) {
+        selectSearchMatch(index);
+        _currentSearchResult = index + 1;
+        updateSearchCountLabelText();
     }
 
     if (updateUI) {
@@ -401,34 +844,34 @@ bool QPlainTextEditSearchWidget::doSearch(bool searchDown,
  * @brief Counts the search results
  */
 void QPlainTextEditSearchWidget::doSearchCount() {
-    // Note that we are moving the anchor, so the search will start from the top
-    // again! Alternative: Restore cursor position afterward, but then we will
-    // not know
-    //              at what _currentSearchResult we currently are
-    _textEdit->moveCursor(QTextCursor::Start, QTextCursor::MoveAnchor);
-
-    bool found;
-    _searchResultCount = 0;
+    updateSearchMatches();
     _currentSearchResult = 0;
-    const int searchMode = ui->modeComboBox->currentIndex();
 
-    do {
-        found = doSearch(true, false, false);
-        if (found) {
-            _searchResultCount++;
-        }
-
-        // prevent infinite loops from regular expression searches like "$", "^"
-        // or "\b"
-        if (searchMode == RegularExpressionMode &&
-            _searchResultCount >= 10000) {
-            break;
-        }
-    } while (found);
+    // the next search will start from the top again, without moving the
+    // cursor of the text edit
+    _searchFromTop = true;
 
     updateSearchCountLabelText();
 }
 
+/**
+ * @brief Selects a search match in the text edit
+ * @param index
+ */
+void QPlainTextEditSearchWidget::selectSearchMatch(int index) {
+    const SearchMatch &match = _searchMatches.at(index);
+    QTextCursor cursor = _textEdit->textCursor();
+    cursor.setPosition(match.position);
+    cursor.setPosition(match.position + match.length, QTextCursor::KeepAnchor);
+
+    // block signal to reduce too many signals being fired and too many updates
+    _textEdit->blockSignals(true);
+    _textEdit->setTextCursor(cursor);
+    _textEdit->blockSignals(false);
+
+    _textEdit->ensureCursorVisible();
+}
+
 void QPlainTextEditSearchWidget::setDarkMode(bool enabled) {
     _darkMode = enabled;
 }
@@ -474,12 +917,17 @@ void QPlainTextEditSearchWidget::reset() {
 }
 
 void QPlainTextEditSearchWidget::updateSearchCountLabelText() {
+    // while the document is searched there are at least that many results
+    QString count = _searchResultCount == 0 && _searchScanPosition == -1
+                        ? QStringLiteral("-")
+                        : QString::number(_searchResultCount);
+    if (_searchScanPosition != -1) count += QLatin1Char('+');
+
     ui->searchCountLabel->setEnabled(true);
     ui->searchCountLabel->setText(QStringLiteral("%1/%2").arg(
-        _currentSearchResult == 0 ? QChar('-')
+        _currentSearchResult == 0 ? QStringLiteral("-")
                                   : QString::number(_currentSearchResult),
-        _searchResultCount == 0 ? QChar('-')
-                                : QString::number(_searchResultCount)));
+        count));
 }
 
 void QPlainTextEditSearchWidget::setSearchSelectionColor(const QColor &color) {
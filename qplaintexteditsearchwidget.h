@@ -25,7 +25,11 @@
 #pragma once
 
 #include <QPlainTextEdit>
+#include <QPointer>
+#include <QRegularExpression>
+#include <QStringMatcher>
 #include <QTimer>
+#include <QVector>
 #include <QWidget>
 
 namespace Ui {
@@ -50,8 +54,19 @@ class QPlainTextEditSearchWidget : public QWidget {
     void activate(bool focus);
     void clearSearchExtraSelections();
     void updateSearchExtraSelections();
+    void setVisibleSearchExtraSelectionsOnly(bool enabled);
+    inline bool visibleSearchExtraSelectionsOnly() const {
+        return _visibleSearchExtraSelectionsOnly;
+    }
+    void completeSearch();
+    inline bool searchComplete() const { return _searchScanPosition == -1; }
 
    private:
+    struct SearchMatch {
+        int position;
+        int length;
+    };
+
     Ui::QPlainTextEditSearchWidget *ui;
     int _searchResultCount;
     int _currentSearchResult;
@@ -59,8 +74,37 @@ class QPlainTextEditSearchWidget : public QWidget {
     QColor selectionColor;
     QTimer _debounceTimer;
     QString _searchTerm;
+    // all matches of the search in the document, sorted by their position
+    QVector<SearchMatch> _searchMatches;
+    QString _searchMatchesText;
+    int _searchMatchesMode = -1;
+    bool _searchMatchesCaseSensitive = false;
+    bool _searchMatchesDirty = true;
+    bool _searchFromTop = false;
+    bool _showSearchExtraSelections = false;
+    bool _visibleSearchExtraSelectionsOnly = true;
+    QStringMatcher _searchMatcher;
+    QRegularExpression _searchRegExp;
+    QPointer<QTextDocument> _searchDocument;
+    QMetaObject::Connection _searchDocumentConnection;
+    // position of the next block that is searched for matches, -1 after all
+    // blocks were searched
+    int _searchScanPosition = -1;
+    QTimer _searchScanTimer;
     void setSearchExtraSelections() const;
     void stopDebounce();
+    void updateSearchMatches();
+    void scanSearchMatches(int budget, int untilPosition = -1);
+    void cancelSearchScan();
+    void continueSearchScan();
+    void watchSearchDocument();
+    void updateSearchMatchesAfterChange(int position, int charsRemoved,
+                                        int charsAdded);
+    void findSearchMatches(const QString &text, int position,
+                           QVector<SearchMatch> &matches) const;
+    int findSearchMatch(int position, bool searchDown) const;
+    void selectSearchMatch(int index);
+    void updateVisibleSearchExtraSelections();
 
    protected:
     QPlainTextEdit *_textEdit;